@@ -0,0 +1,539 @@
+// Lexilla lexer library
+/** @file BatchDocument.cxx
+ ** Implementation of IDocument for applications that lex text without a Scintilla editor.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstring>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "BatchDocument.h"
+
+using namespace Lexilla;
+
+namespace {
+
+// Same values as Scintilla.h but that is not needed by applications using just ILexer.h
+constexpr int levelBase = 0x400;
+constexpr int tabWidth = 8;
+constexpr int codePageUTF8 = 65001;
+
+constexpr bool IsTrailByte(unsigned char ch) noexcept {
+	return (ch >= 0x80) && (ch < 0xc0);
+}
+
+constexpr int UTF8BytesOfLead(unsigned char ch) noexcept {
+	if (ch < 0xC2) {
+		// ASCII or trail byte or overlong
+		return 1;
+	} else if (ch < 0xE0) {
+		return 2;
+	} else if (ch < 0xF0) {
+		return 3;
+	} else if (ch < 0xF5) {
+		return 4;
+	}
+	return 1;
+}
+
+constexpr bool StyleRunBefore(Sci_Position position, const BatchDocument::StyleRun &run) noexcept {
+	return position < run.start;
+}
+
+}
+
+BatchDocument::BatchDocument(bool storeLevels_) :
+	storeLevels(storeLevels_), codePage(codePageUTF8), errorStatus(0),
+	runsAfterFirst(0), styling(false), endStyled(0) {
+	Analyse();
+}
+
+void BatchDocument::FindLineStarts() {
+	lineStarts.clear();
+	lineStarts.push_back(0);
+	if (text.empty()) {
+		return;
+	}
+	const char *const start = text.data();
+	const char *const end = start + text.length();
+	if (!std::memchr(start, '\r', text.length())) {
+		// Common case of only '\n' line ends so use memchr which C libraries vectorise
+		const char *p = start;
+		while ((p < end) && ((p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr)) {
+			p++;
+			lineStarts.push_back(p - start);
+		}
+	} else {
+		// Mixture of '\r', '\n', and "\r\n" line ends
+		const Sci_Position length = text.length();
+		for (Sci_Position position = 0; position < length; position++) {
+			const char ch = text[position];
+			if (ch == '\r') {
+				if ((position + 1 < length) && (text[position + 1] == '\n')) {
+					position++;
+				}
+				lineStarts.push_back(position + 1);
+			} else if (ch == '\n') {
+				lineStarts.push_back(position + 1);
+			}
+		}
+	}
+}
+
+void BatchDocument::Analyse() {
+	FindLineStarts();
+	// Lexers may set state for the line after the last line
+	lineStates.assign(lineStarts.size() + 1, 0);
+	if (storeLevels) {
+		lineLevels.assign(lineStarts.size() + 1, levelBase);
+	} else {
+		lineLevels.clear();
+	}
+	runs.clear();
+	runsAfter.clear();
+	runsAfterFirst = 0;
+	styling = false;
+	endStyled = 0;
+	if (!text.empty()) {
+		runs.push_back({ 0, 0 });
+	}
+	errorStatus = 0;
+}
+
+void BatchDocument::Set(std::string_view sv) {
+	textOwned.assign(sv);
+	text = textOwned;
+	Analyse();
+}
+
+void BatchDocument::Borrow(std::string_view sv) {
+	textOwned.clear();
+	text = sv;
+	Analyse();
+}
+
+void BatchDocument::Reset() {
+	textOwned.clear();
+	text = {};
+	Analyse();
+}
+
+void BatchDocument::SetCodePage(int codePage_) noexcept {
+	codePage = codePage_;
+}
+
+std::string_view BatchDocument::Text() const noexcept {
+	return text;
+}
+
+Sci_Position BatchDocument::LineCount() const noexcept {
+	return lineStarts.size();
+}
+
+int BatchDocument::ErrorStatus() const noexcept {
+	return errorStatus;
+}
+
+Sci_Position BatchDocument::EndStyled() const noexcept {
+	return endStyled;
+}
+
+const std::vector<BatchDocument::StyleRun> &BatchDocument::StyleRuns() {
+	EndStyling();
+	return runs;
+}
+
+void BatchDocument::AppendStyle(Sci_Position length, char style) {
+	if (!styling) {
+		StartStyling(endStyled);
+	}
+	length = std::min(length, Length() - endStyled);
+	if (length <= 0) {
+		return;
+	}
+	if (runs.empty() || (runs.back().style != style)) {
+		runs.push_back({ endStyled, style });
+	}
+	endStyled += length;
+	// Drop runs that have been completely overwritten and trim the first survivor
+	while ((runsAfterFirst + 1 < runsAfter.size()) && (runsAfter[runsAfterFirst + 1].start <= endStyled)) {
+		runsAfterFirst++;
+	}
+	if ((runsAfterFirst < runsAfter.size()) && (runsAfter[runsAfterFirst].start < endStyled)) {
+		runsAfter[runsAfterFirst].start = endStyled;
+	}
+}
+
+// Start of the stored run containing position which may follow a run with the same style
+// as runs and runsAfter are not merged until styling ends.
+Sci_Position BatchDocument::StoredRunStart(Sci_Position position) const noexcept {
+	const bool after = styling && (position >= endStyled);
+	const std::vector<StyleRun> &runsSearch = after ? runsAfter : runs;
+	const std::vector<StyleRun>::const_iterator itFirst = runsSearch.begin() + (after ? runsAfterFirst : 0);
+	const std::vector<StyleRun>::const_iterator it = std::upper_bound(itFirst, runsSearch.end(), position, StyleRunBefore);
+	const Sci_Position startMinimum = after ? endStyled : 0;
+	if (it == itFirst) {
+		return startMinimum;
+	}
+	return std::max((it - 1)->start, startMinimum);
+}
+
+void BatchDocument::EndStyling() {
+	if (!styling) {
+		return;
+	}
+	for (size_t i = runsAfterFirst; i < runsAfter.size(); i++) {
+		const StyleRun &run = runsAfter[i];
+		if (run.start >= Length()) {
+			break;
+		}
+		if (runs.empty() || (runs.back().style != run.style)) {
+			runs.push_back(run);
+		}
+	}
+	runsAfter.clear();
+	runsAfterFirst = 0;
+	styling = false;
+}
+
+bool BatchDocument::IsDBCSLeadByteNoExcept(char ch) const noexcept {
+	// Byte ranges found in Wikipedia articles with relevant search strings in each case
+	const unsigned char uch = ch;
+	switch (codePage) {
+	case 932:
+		// Shift_jis
+		return ((uch >= 0x81) && (uch <= 0x9F)) ||
+			((uch >= 0xE0) && (uch <= 0xFC));
+	case 936:
+		// GBK
+		return (uch >= 0x81) && (uch <= 0xFE);
+	case 949:
+		// Korean Wansung KS C-5601-1987
+		return (uch >= 0x81) && (uch <= 0xFE);
+	case 950:
+		// Big5
+		return (uch >= 0x81) && (uch <= 0xFE);
+	case 1361:
+		// Korean Johab KS C-5601-1992
+		return
+			((uch >= 0x84) && (uch <= 0xD3)) ||
+			((uch >= 0xD8) && (uch <= 0xDE)) ||
+			((uch >= 0xE0) && (uch <= 0xF9));
+	default:
+		break;
+	}
+	return false;
+}
+
+#if defined(_MSC_VER)
+// IDocument interface does not specify noexcept so best to not add it to implementation
+#pragma warning(disable: 26440)
+#endif
+
+int SCI_METHOD BatchDocument::Version() const {
+	return dvStyleRuns;
+}
+
+void SCI_METHOD BatchDocument::SetErrorStatus(int status) {
+	errorStatus = status;
+}
+
+Sci_Position SCI_METHOD BatchDocument::Length() const {
+	return text.length();
+}
+
+void SCI_METHOD BatchDocument::GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
+	if ((position < 0) || (lengthRetrieve <= 0) || (position >= Length())) {
+		return;
+	}
+	lengthRetrieve = std::min(lengthRetrieve, Length() - position);
+	memcpy(buffer, text.data() + position, lengthRetrieve);
+}
+
+char SCI_METHOD BatchDocument::StyleAt(Sci_Position position) const {
+	if ((position < 0) || (position >= Length())) {
+		return 0;
+	}
+	const bool after = styling && (position >= endStyled);
+	const std::vector<StyleRun> &runsSearch = after ? runsAfter : runs;
+	const std::vector<StyleRun>::const_iterator itFirst = runsSearch.begin() + (after ? runsAfterFirst : 0);
+	const std::vector<StyleRun>::const_iterator it = std::upper_bound(itFirst, runsSearch.end(), position, StyleRunBefore);
+	if (it == itFirst) {
+		return 0;
+	}
+	return (it - 1)->style;
+}
+
+Sci_Position SCI_METHOD BatchDocument::LineFromPosition(Sci_Position position) const {
+	const std::vector<Sci_Position>::const_iterator it = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+	if (it == lineStarts.begin()) {
+		return 0;
+	}
+	return it - lineStarts.begin() - 1;
+}
+
+Sci_Position SCI_METHOD BatchDocument::LineStart(Sci_Position line) const {
+	if (line < 0) {
+		return 0;
+	}
+	if (line >= LineCount()) {
+		return Length();
+	}
+	return lineStarts[line];
+}
+
+int SCI_METHOD BatchDocument::GetLevel(Sci_Position line) const {
+	if ((line < 0) || (line >= static_cast<Sci_Position>(lineLevels.size()))) {
+		return levelBase;
+	}
+	return lineLevels[line];
+}
+
+int SCI_METHOD BatchDocument::SetLevel(Sci_Position line, int level) {
+	if ((line < 0) || (line >= static_cast<Sci_Position>(lineLevels.size()))) {
+		return levelBase;
+	}
+	const int levelPrevious = lineLevels[line];
+	lineLevels[line] = level;
+	return levelPrevious;
+}
+
+int SCI_METHOD BatchDocument::GetLineState(Sci_Position line) const {
+	if ((line < 0) || (line >= static_cast<Sci_Position>(lineStates.size()))) {
+		return 0;
+	}
+	return lineStates[line];
+}
+
+int SCI_METHOD BatchDocument::SetLineState(Sci_Position line, int state) {
+	if ((line < 0) || (line >= static_cast<Sci_Position>(lineStates.size()))) {
+		return 0;
+	}
+	const int statePrevious = lineStates[line];
+	lineStates[line] = state;
+	return statePrevious;
+}
+
+void SCI_METHOD BatchDocument::StartStyling(Sci_Position position) {
+	EndStyling();
+	position = std::clamp<Sci_Position>(position, 0, Length());
+	// Move runs at or after position into runsAfter, splitting the run containing position
+	std::vector<StyleRun>::iterator it = std::upper_bound(runs.begin(), runs.end(), position, StyleRunBefore);
+	if (it != runs.begin()) {
+		const StyleRun &runContaining = *(it - 1);
+		if (runContaining.start < position) {
+			runsAfter.push_back({ position, runContaining.style });
+		} else {
+			--it;
+		}
+	}
+	runsAfter.insert(runsAfter.end(), it, runs.end());
+	runs.erase(it, runs.end());
+	runsAfterFirst = 0;
+	endStyled = position;
+	styling = true;
+}
+
+bool SCI_METHOD BatchDocument::SetStyleFor(Sci_Position length, char style) {
+	AppendStyle(length, style);
+	return true;
+}
+
+bool SCI_METHOD BatchDocument::SetStyles(Sci_Position length, const char *styles) {
+	Sci_Position i = 0;
+	while (i < length) {
+		const char style = styles[i];
+		Sci_Position end = i + 1;
+		while ((end < length) && (styles[end] == style)) {
+			end++;
+		}
+		AppendStyle(end - i, style);
+		i = end;
+	}
+	return true;
+}
+
+void SCI_METHOD BatchDocument::DecorationSetCurrentIndicator(int) {
+	// Indicators are not stored
+}
+
+void SCI_METHOD BatchDocument::DecorationFillRange(Sci_Position, int, Sci_Position) {
+	// Indicators are not stored
+}
+
+void SCI_METHOD BatchDocument::ChangeLexerState(Sci_Position, Sci_Position) {
+	// Text is immutable so there is no need to relex
+}
+
+int SCI_METHOD BatchDocument::CodePage() const {
+	return codePage;
+}
+
+bool SCI_METHOD BatchDocument::IsDBCSLeadByte(char ch) const {
+	return IsDBCSLeadByteNoExcept(ch);
+}
+
+const char *SCI_METHOD BatchDocument::BufferPointer() {
+	return text.data();
+}
+
+int SCI_METHOD BatchDocument::GetLineIndentation(Sci_Position line) {
+	int indent = 0;
+	const Sci_Position lineEnd = LineEnd(line);
+	for (Sci_Position position = LineStart(line); position < lineEnd; position++) {
+		const char ch = text[position];
+		if (ch == ' ') {
+			indent++;
+		} else if (ch == '\t') {
+			indent = indent / tabWidth * tabWidth + tabWidth;
+		} else {
+			break;
+		}
+	}
+	return indent;
+}
+
+Sci_Position SCI_METHOD BatchDocument::LineEnd(Sci_Position line) const {
+	line = std::max<Sci_Position>(line, 0);
+	if (line >= LineCount() - 1) {
+		return Length();
+	}
+	const Sci_Position start = lineStarts[line];
+	Sci_Position position = lineStarts[line + 1];
+	if ((position > start) && (text[position - 1] == '\n')) {
+		position--;
+	}
+	if ((position > start) && (text[position - 1] == '\r')) {
+		position--;
+	}
+	return position;
+}
+
+Sci_Position SCI_METHOD BatchDocument::GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const {
+	Sci_Position position = positionStart;
+	if (codePage == codePageUTF8) {
+		while (characterOffset > 0) {
+			if (position >= Length()) {
+				return -1;
+			}
+			Sci_Position width = 1;
+			GetCharacterAndWidth(position, &width);
+			position += width;
+			characterOffset--;
+		}
+		while (characterOffset < 0) {
+			if (position <= 0) {
+				return -1;
+			}
+			// Back over up to 3 trail bytes then check they form a character with the lead
+			Sci_Position positionPrevious = position - 1;
+			while ((positionPrevious > 0) && (position - positionPrevious < 4) &&
+				IsTrailByte(text[positionPrevious])) {
+				positionPrevious--;
+			}
+			Sci_Position width = 1;
+			GetCharacterAndWidth(positionPrevious, &width);
+			position = (positionPrevious + width == position) ? positionPrevious : position - 1;
+			characterOffset++;
+		}
+		return position;
+	}
+	if (IsDBCSLeadByteNoExcept('\x81') || IsDBCSLeadByteNoExcept('\x84')) {
+		// DBCS: forwards is simple but backwards is ambiguous so walk from line start
+		while (characterOffset > 0) {
+			if (position >= Length()) {
+				return -1;
+			}
+			Sci_Position width = 1;
+			GetCharacterAndWidth(position, &width);
+			position += width;
+			characterOffset--;
+		}
+		while (characterOffset < 0) {
+			if (position <= 0) {
+				return -1;
+			}
+			Sci_Position positionPrevious = LineStart(LineFromPosition(position - 1));
+			for (;;) {
+				Sci_Position width = 1;
+				GetCharacterAndWidth(positionPrevious, &width);
+				if (positionPrevious + width >= position) {
+					break;
+				}
+				positionPrevious += width;
+			}
+			position = positionPrevious;
+			characterOffset++;
+		}
+		return position;
+	}
+	position = positionStart + characterOffset;
+	if ((position < 0) || (position > Length())) {
+		return -1;
+	}
+	return position;
+}
+
+int SCI_METHOD BatchDocument::GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const {
+	// Return NULs before document start and after document end
+	Sci_Position width = 1;
+	int character = 0;
+	if ((position >= 0) && (position < Length())) {
+		const unsigned char leadByte = text[position];
+		character = leadByte;
+		if (leadByte >= 0x80) {
+			if (codePage == codePageUTF8) {
+				const int widthCharBytes = UTF8BytesOfLead(leadByte);
+				bool valid = (widthCharBytes > 1) && (position + widthCharBytes <= Length());
+				int value = leadByte & (0x7F >> widthCharBytes);
+				for (int b = 1; valid && (b < widthCharBytes); b++) {
+					const unsigned char trail = text[position + b];
+					valid = IsTrailByte(trail);
+					value = (value << 6) | (trail & 0x3F);
+				}
+				if (valid) {
+					width = widthCharBytes;
+					character = value;
+				} else {
+					// Invalid bytes are represented as lone surrogates like Scintilla
+					character = 0xDC80 + leadByte;
+				}
+			} else if (IsDBCSLeadByteNoExcept(leadByte) && (position + 1 < Length())) {
+				const unsigned char trailByte = text[position + 1];
+				width = 2;
+				character = (leadByte << 8) | trailByte;
+			}
+		}
+	}
+	if (pWidth) {
+		*pWidth = width;
+	}
+	return character;
+}
+
+void SCI_METHOD BatchDocument::SetStyleRun(Sci_Position start, Sci_Position length, char style) {
+	if (!styling || (start != endStyled)) {
+		StartStyling(start);
+	}
+	AppendStyle(length, style);
+}
+
+Sci_Position SCI_METHOD BatchDocument::StyleRunStart(Sci_Position position) const {
+	if ((position <= 0) || (position >= Length())) {
+		return std::max<Sci_Position>(position, 0);
+	}
+	const char style = StyleAt(position);
+	Sci_Position start = StoredRunStart(position);
+	while ((start > 0) && (StyleAt(start - 1) == style)) {
+		start = StoredRunStart(start - 1);
+	}
+	return start;
+}
@@ -0,0 +1,106 @@
+// Lexilla lexer library
+/** @file BatchDocument.h
+ ** Implementation of IDocument for applications that lex text without a Scintilla editor.
+ ** Text may be copied into the document or borrowed from memory owned by the application
+ ** such as a memory-mapped file.
+ ** Styles are stored as runs instead of one byte per position and lexers send runs directly
+ ** through IDocumentStyleRuns.
+ ** This depends only on ILexer.h and Lexilla.h so can be copied out into other projects.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BATCHDOCUMENT_H
+#define BATCHDOCUMENT_H
+
+namespace Lexilla {
+
+class BatchDocument : public IDocumentStyleRuns {
+public:
+	// A style that continues from start until the start of the next run or the document end.
+	struct StyleRun {
+		Sci_Position start;
+		char style;
+	};
+private:
+	std::string textOwned;
+	std::string_view text;
+	std::vector<Sci_Position> lineStarts;
+	std::vector<int> lineStates;
+	std::vector<int> lineLevels;
+	bool storeLevels;
+	int codePage;
+	int errorStatus;
+
+	// While styling, runs covers [0, endStyled) and the runs after endStyled that have not
+	// yet been overwritten are held in runsAfter from runsAfterFirst onwards.
+	std::vector<StyleRun> runs;
+	std::vector<StyleRun> runsAfter;
+	size_t runsAfterFirst;
+	bool styling;
+	Sci_Position endStyled;
+
+	void FindLineStarts();
+	void Analyse();
+	void AppendStyle(Sci_Position length, char style);
+	Sci_Position StoredRunStart(Sci_Position position) const noexcept;
+	void EndStyling();
+	bool IsDBCSLeadByteNoExcept(char ch) const noexcept;
+public:
+	explicit BatchDocument(bool storeLevels_=true);
+	// Deleted so BatchDocument objects can not be copied.
+	BatchDocument(const BatchDocument &) = delete;
+	BatchDocument(BatchDocument &&) = delete;
+	BatchDocument &operator=(const BatchDocument &) = delete;
+	BatchDocument &operator=(BatchDocument &&) = delete;
+	virtual ~BatchDocument() = default;
+
+	// Copy text into the document.
+	void Set(std::string_view sv);
+	// Use text without copying. The memory must remain valid and unchanged until the
+	// document is Reset, Set, or Borrows other text.
+	// Borrowed text may not be NUL-terminated so BufferPointer may not be either.
+	void Borrow(std::string_view sv);
+	// Make empty but retain allocated memory so the document can be reused.
+	void Reset();
+	// Defaults to UTF-8 (65001). Other code pages are treated as single byte unless DBCS.
+	void SetCodePage(int codePage_) noexcept;
+
+	std::string_view Text() const noexcept;
+	Sci_Position LineCount() const noexcept;
+	int ErrorStatus() const noexcept;
+	Sci_Position EndStyled() const noexcept;
+	// The style runs covering the whole document with each run different to its predecessor.
+	const std::vector<StyleRun> &StyleRuns();
+
+	int SCI_METHOD Version() const override;
+	void SCI_METHOD SetErrorStatus(int status) override;
+	Sci_Position SCI_METHOD Length() const override;
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override;
+	char SCI_METHOD StyleAt(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles) override;
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+	void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) override;
+	void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+	int SCI_METHOD CodePage() const override;
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+	const char *SCI_METHOD BufferPointer() override;
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override;
+
+	void SCI_METHOD SetStyleRun(Sci_Position start, Sci_Position length, char style) override;
+	Sci_Position SCI_METHOD StyleRunStart(Sci_Position position) const override;
+};
+
+}
+
+#endif
@@ -0,0 +1,242 @@
+// Lexilla lexer library
+/** @file LexerSnapshot.cxx
+ ** Save the results and state of lexing a BatchDocument.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstdint>
+
+#include <utility>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "BatchDocument.h"
+#include "LexerSnapshot.h"
+
+using namespace Lexilla;
+
+namespace {
+
+// FNV-1a which is fast and good enough to detect changed text
+constexpr uint64_t hashStart = 0xcbf29ce484222325ULL;
+
+uint64_t HashAppend(uint64_t hash, std::string_view sv) noexcept {
+	for (const char ch : sv) {
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+constexpr std::string_view snapshotTag = "LexerSnapshot1";
+
+void PutNumber(std::string &data, uint64_t value) {
+	while (value >= 0x80) {
+		data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	data.push_back(static_cast<char>(value));
+}
+
+// Values in a snapshot are never negative
+bool GetNumber(std::string_view &data, uint64_t &value) noexcept {
+	value = 0;
+	for (size_t shift = 0; shift < 64; shift += 7) {
+		if (data.empty()) {
+			return false;
+		}
+		const unsigned char uch = data.front();
+		data.remove_prefix(1);
+		value |= static_cast<uint64_t>(uch & 0x7F) << shift;
+		if (!(uch & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename T>
+bool Get(std::string_view &data, T &value) noexcept {
+	uint64_t u = 0;
+	if (!GetNumber(data, u)) {
+		return false;
+	}
+	value = static_cast<T>(u);
+	return true;
+}
+
+// Each item takes at least one byte so a count larger than the remaining data is malformed.
+bool GetCount(std::string_view &data, size_t &count) noexcept {
+	return Get(data, count) && (count <= data.length());
+}
+
+}
+
+LexerSnapshot::LexerSnapshot(Sci_Position linesPerCheckpoint_) noexcept :
+	linesPerCheckpoint(std::max<Sci_Position>(linesPerCheckpoint_, 1)) {
+}
+
+bool LexerSnapshot::Save(BatchDocument &doc, Scintilla::ILexer5 *plex) {
+	LexerStateBuffer buffer { nullptr, 0 };
+	if (!plex->PrivateCall(LEXILLA_PRIVATECALL_SAVESTATE, &buffer)) {
+		return false;
+	}
+	lexerState.resize(buffer.length);
+	buffer.data = lexerState.data();
+	plex->PrivateCall(LEXILLA_PRIVATECALL_SAVESTATE, &buffer);
+
+	styles = doc.StyleRuns();
+
+	const Sci_Position lines = doc.LineCount();
+	lineStates.clear();
+	levels.clear();
+	for (Sci_Position line = 0; line < lines; line++) {
+		lineStates.push_back(doc.GetLineState(line));
+		levels.push_back(doc.GetLevel(line));
+	}
+
+	// The start of the last line is always a checkpoint so unchanged text followed by
+	// appended text restores as much as possible.
+	const std::string_view text = doc.Text();
+	checkpoints.clear();
+	uint64_t hash = hashStart;
+	Sci_Position position = 0;
+	for (Sci_Position line = linesPerCheckpoint; ; line += linesPerCheckpoint) {
+		line = std::min(line, lines - 1);
+		if (line <= 0) {
+			break;
+		}
+		const Sci_Position positionLine = doc.LineStart(line);
+		hash = HashAppend(hash, text.substr(position, positionLine - position));
+		position = positionLine;
+		checkpoints.push_back({ line, position, hash });
+		if (line == lines - 1) {
+			break;
+		}
+	}
+	return true;
+}
+
+Sci_Position LexerSnapshot::Restore(BatchDocument &doc, Scintilla::ILexer5 *plex) const {
+	const std::string_view text = doc.Text();
+	const Checkpoint *pMatch = nullptr;
+	uint64_t hash = hashStart;
+	Sci_Position position = 0;
+	for (const Checkpoint &checkpoint : checkpoints) {
+		if ((checkpoint.position > static_cast<Sci_Position>(text.length())) ||
+			(doc.LineStart(checkpoint.line) != checkpoint.position)) {
+			break;
+		}
+		hash = HashAppend(hash, text.substr(position, checkpoint.position - position));
+		position = checkpoint.position;
+		if (hash != checkpoint.hash) {
+			break;
+		}
+		pMatch = &checkpoint;
+	}
+	if (!pMatch) {
+		return 0;
+	}
+
+	LexerStateBuffer buffer { const_cast<char *>(lexerState.data()), lexerState.length() };
+	if (!plex->PrivateCall(LEXILLA_PRIVATECALL_RESTORESTATE, &buffer)) {
+		return 0;
+	}
+
+	const Sci_Position end = pMatch->position;
+	doc.StartStyling(0);
+	for (size_t i = 0; (i < styles.size()) && (styles[i].start < end); i++) {
+		const Sci_Position endRun = (i + 1 < styles.size()) ? std::min(styles[i + 1].start, end) : end;
+		doc.SetStyleRun(styles[i].start, endRun - styles[i].start, styles[i].style);
+	}
+	for (Sci_Position line = 0; line < pMatch->line; line++) {
+		doc.SetLineState(line, lineStates[line]);
+		doc.SetLevel(line, levels[line]);
+	}
+	return end;
+}
+
+std::string LexerSnapshot::Serialize() const {
+	std::string data(snapshotTag);
+	PutNumber(data, linesPerCheckpoint);
+	PutNumber(data, checkpoints.size());
+	for (const Checkpoint &checkpoint : checkpoints) {
+		PutNumber(data, checkpoint.line);
+		PutNumber(data, checkpoint.position);
+		PutNumber(data, checkpoint.hash);
+	}
+	PutNumber(data, lexerState.length());
+	data.append(lexerState);
+	PutNumber(data, styles.size());
+	for (const BatchDocument::StyleRun &run : styles) {
+		PutNumber(data, run.start);
+		PutNumber(data, static_cast<unsigned char>(run.style));
+	}
+	// Line states and levels are for the same lines
+	PutNumber(data, lineStates.size());
+	for (size_t line = 0; line < lineStates.size(); line++) {
+		PutNumber(data, static_cast<unsigned int>(lineStates[line]));
+		PutNumber(data, static_cast<unsigned int>(levels[line]));
+	}
+	return data;
+}
+
+bool LexerSnapshot::Deserialize(std::string_view data) {
+	if (data.substr(0, snapshotTag.length()) != snapshotTag) {
+		return false;
+	}
+	data.remove_prefix(snapshotTag.length());
+	LexerSnapshot snapshot;
+	size_t count = 0;
+	if (!Get(data, snapshot.linesPerCheckpoint) || !GetCount(data, count)) {
+		return false;
+	}
+	for (size_t i = 0; i < count; i++) {
+		Checkpoint checkpoint {};
+		if (!Get(data, checkpoint.line) || !Get(data, checkpoint.position) || !Get(data, checkpoint.hash)) {
+			return false;
+		}
+		snapshot.checkpoints.push_back(checkpoint);
+	}
+	size_t length = 0;
+	if (!Get(data, length) || (length > data.length())) {
+		return false;
+	}
+	snapshot.lexerState = data.substr(0, length);
+	data.remove_prefix(length);
+	if (!GetCount(data, count)) {
+		return false;
+	}
+	for (size_t i = 0; i < count; i++) {
+		BatchDocument::StyleRun run {};
+		if (!Get(data, run.start) || !Get(data, run.style)) {
+			return false;
+		}
+		snapshot.styles.push_back(run);
+	}
+	if (!GetCount(data, count)) {
+		return false;
+	}
+	for (size_t line = 0; line < count; line++) {
+		unsigned int lineState = 0;
+		unsigned int level = 0;
+		if (!Get(data, lineState) || !Get(data, level)) {
+			return false;
+		}
+		snapshot.lineStates.push_back(static_cast<int>(lineState));
+		snapshot.levels.push_back(static_cast<int>(level));
+	}
+	// Checkpoints must be for lines that have been saved
+	if (!data.empty() || (!snapshot.checkpoints.empty() &&
+		(snapshot.checkpoints.back().line > static_cast<Sci_Position>(snapshot.lineStates.size())))) {
+		return false;
+	}
+	*this = std::move(snapshot);
+	return true;
+}
@@ -0,0 +1,49 @@
+// Lexilla lexer library
+/** @file LexerSnapshot.h
+ ** Save the results and state of lexing a BatchDocument so that a later process lexing the
+ ** same text, or text that starts with the same lines, can skip the unchanged lines.
+ ** A snapshot holds the styles, line states and fold levels of the document, the state
+ ** that the lexer saves with LEXILLA_PRIVATECALL_SAVESTATE, and hashes of the text before
+ ** checkpoint lines which show how much of new text is unchanged.
+ ** The lexer that restores a snapshot must have the same properties and word lists as the
+ ** lexer that saved it.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LEXERSNAPSHOT_H
+#define LEXERSNAPSHOT_H
+
+namespace Lexilla {
+
+class LexerSnapshot {
+	struct Checkpoint {
+		Sci_Position line;
+		Sci_Position position;
+		// Hash of the text before position
+		uint64_t hash;
+	};
+	Sci_Position linesPerCheckpoint;
+	std::vector<Checkpoint> checkpoints;
+	std::string lexerState;
+	std::vector<BatchDocument::StyleRun> styles;
+	std::vector<int> lineStates;
+	std::vector<int> levels;
+public:
+	explicit LexerSnapshot(Sci_Position linesPerCheckpoint_=1000) noexcept;
+
+	// Save doc after it has been lexed and folded by plex.
+	// Returns false when plex can not save its state.
+	bool Save(BatchDocument &doc, Scintilla::ILexer5 *plex);
+	// Restore the results for the longest prefix of lines that match into doc and restore the
+	// state of plex. Returns the position from which doc should be lexed and folded which is 0
+	// when nothing could be restored.
+	Sci_Position Restore(BatchDocument &doc, Scintilla::ILexer5 *plex) const;
+
+	// Convert to and from bytes that can be written to a file.
+	std::string Serialize() const;
+	bool Deserialize(std::string_view data);
+};
+
+}
+
+#endif
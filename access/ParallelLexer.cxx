@@ -0,0 +1,189 @@
+// Lexilla lexer library
+/** @file ParallelLexer.cxx
+ ** Lex a BatchDocument with multiple threads.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "BatchDocument.h"
+#include "ParallelLexer.h"
+
+using namespace Lexilla;
+
+namespace {
+
+struct Chunk {
+	Sci_Position lineStart = 0;
+	Sci_Position lineEnd = 0;
+	Scintilla::ILexer5 *plex = nullptr;
+	// Speculative results. When the lexer found a line to split at, doc holds the text from
+	// that line as if it were a whole document so line 0 of doc is lineStart of the full
+	// document. Otherwise doc holds all the text so its positions are those of the full
+	// document and the lexer can examine text before the chunk.
+	std::unique_ptr<BatchDocument> doc;
+	Sci_Position lineOffset = 0;
+};
+
+int StyleBefore(const Scintilla::IDocument &doc, Sci_Position position) {
+	if (position <= 0) {
+		return 0;
+	}
+	const unsigned char style = doc.StyleAt(position - 1);
+	return style;
+}
+
+// The state passed on to the next line is the style at the end of the line, the line state,
+// and, when folding, the fold level.
+bool SameStateAfterLine(const Scintilla::IDocument &doc, const Chunk &chunk, Sci_Position line, bool fold) {
+	const Sci_Position lineChunk = line - chunk.lineOffset;
+	if ((StyleBefore(doc, doc.LineStart(line + 1)) != StyleBefore(*chunk.doc, chunk.doc->LineStart(lineChunk + 1))) ||
+		(doc.GetLineState(line) != chunk.doc->GetLineState(lineChunk))) {
+		return false;
+	}
+	return !fold || (doc.GetLevel(line) == chunk.doc->GetLevel(lineChunk));
+}
+
+// When the lexer holds state for each line, take the chunk lexer's state from line onwards.
+// Lexers that do not hold such state do not implement the operation so are already joined.
+bool JoinLexerState(Scintilla::ILexer5 *plex, const Chunk &chunk, Sci_Position line) {
+	JoinState join { chunk.plex, chunk.lineOffset, line, false };
+	return !plex->PrivateCall(LEXILLA_PRIVATECALL_JOINSTATE, &join) || join.joined;
+}
+
+void LexLines(Scintilla::ILexer5 *plex, Scintilla::IDocument &doc, Sci_Position lineStart, Sci_Position lineEnd, bool fold) {
+	const Sci_Position start = doc.LineStart(lineStart);
+	const Sci_Position end = doc.LineStart(lineEnd);
+	if (end <= start) {
+		return;
+	}
+	const int initStyle = StyleBefore(doc, start);
+	if (!fold) {
+		plex->Lex(start, end - start, initStyle, &doc);
+		return;
+	}
+	LexFoldRange range { static_cast<Sci_PositionU>(start), end - start, initStyle, &doc };
+	if (!plex->PrivateCall(LEXILLA_PRIVATECALL_LEXFOLD, &range)) {
+		plex->Lex(start, end - start, initStyle, &doc);
+		plex->Fold(start, end - start, initStyle, &doc);
+	}
+}
+
+void CopyLines(BatchDocument &doc, const Chunk &chunk, Sci_Position lineStart, Sci_Position lineEnd, bool fold) {
+	BatchDocument &docFrom = *chunk.doc;
+	for (Sci_Position line = lineStart; line < lineEnd; line++) {
+		doc.SetLineState(line, docFrom.GetLineState(line - chunk.lineOffset));
+	}
+	if (fold) {
+		// Folders may set the level of the line after the range from the level of its last line
+		for (Sci_Position line = lineStart; line <= lineEnd; line++) {
+			doc.SetLevel(line, docFrom.GetLevel(line - chunk.lineOffset));
+		}
+	}
+	const Sci_Position start = doc.LineStart(lineStart);
+	const Sci_Position end = doc.LineStart(lineEnd);
+	if (end <= start) {
+		return;
+	}
+	const Sci_Position offset = doc.LineStart(chunk.lineOffset);
+	const std::vector<BatchDocument::StyleRun> &runs = docFrom.StyleRuns();
+	std::vector<BatchDocument::StyleRun>::const_iterator it = std::upper_bound(runs.begin(), runs.end(), start - offset,
+		[](Sci_Position position, const BatchDocument::StyleRun &run) noexcept {
+		return position < run.start;
+	});
+	if (it != runs.begin()) {
+		--it;
+	}
+	doc.StartStyling(start);
+	Sci_Position position = start;
+	for (; (it != runs.end()) && (position < end); ++it) {
+		const Sci_Position endRun = ((it + 1) == runs.end()) ? end : std::min((it + 1)->start + offset, end);
+		if (endRun > position) {
+			doc.SetStyleFor(endRun - position, it->style);
+			position = endRun;
+		}
+	}
+}
+
+}
+
+std::vector<ChunkResult> Lexilla::LexParallel(BatchDocument &doc, const LexerMaker &maker, size_t chunks, Sci_Position minimumLines, bool fold) {
+	const Sci_Position lines = doc.LineCount();
+	minimumLines = std::max<Sci_Position>(minimumLines, 1);
+	chunks = std::clamp<size_t>(chunks, 1, std::max<Sci_Position>(lines / minimumLines, 1));
+	const Sci_Position linesPerChunk = (lines + chunks - 1) / chunks;
+
+	std::vector<Chunk> work(chunks);
+	for (size_t i = 0; i < chunks; i++) {
+		Chunk &chunk = work[i];
+		chunk.lineStart = std::min<Sci_Position>(i * linesPerChunk, lines);
+		chunk.lineEnd = std::min<Sci_Position>(chunk.lineStart + linesPerChunk, lines);
+		chunk.plex = maker();
+		if (i > 0) {
+			// Move the start to where the lexer can begin again, such as a statement start,
+			// so the speculative lex is more likely to be right.
+			SplitLine split { &doc, chunk.lineStart, chunk.lineEnd };
+			if (chunk.plex->PrivateCall(LEXILLA_PRIVATECALL_SPLITLINE, &split)) {
+				chunk.lineStart = split.line;
+				chunk.lineOffset = split.line;
+				work[i - 1].lineEnd = split.line;
+			}
+			// Fold levels are only needed for speculative lexing when folding
+			chunk.doc = std::make_unique<BatchDocument>(fold);
+			chunk.doc->SetCodePage(doc.CodePage());
+			chunk.doc->Borrow(doc.Text().substr(doc.LineStart(chunk.lineOffset)));
+		}
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunks; i++) {
+		Chunk &chunk = work[i];
+		threads.emplace_back([&chunk, fold]() {
+			LexLines(chunk.plex, *chunk.doc, chunk.lineStart - chunk.lineOffset, chunk.lineEnd - chunk.lineOffset, fold);
+		});
+	}
+	// The first chunk starts from the real initial state so is lexed into the document
+	Scintilla::ILexer5 *plex = work[0].plex;
+	LexLines(plex, doc, work[0].lineStart, work[0].lineEnd, fold);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	std::vector<ChunkResult> results;
+	results.push_back({ work[0].lineStart, work[0].lineEnd, 0, true });
+	for (size_t i = 1; i < chunks; i++) {
+		Chunk &chunk = work[i];
+		ChunkResult result { chunk.lineStart, chunk.lineEnd, 0, chunk.lineStart >= chunk.lineEnd };
+		// Lex again from the chunk start in growing blocks until the state after a block matches.
+		// The state before the chunk is not compared as the speculative lex may have no lines
+		// before the chunk so at least one line is lexed again.
+		Sci_Position line = chunk.lineStart;
+		Sci_Position block = 1;
+		while (!result.converged && (line < chunk.lineEnd)) {
+			const Sci_Position lineEndBlock = std::min(line + block, chunk.lineEnd);
+			LexLines(plex, doc, line, lineEndBlock, fold);
+			result.linesRelexed += lineEndBlock - line;
+			line = lineEndBlock;
+			result.converged = SameStateAfterLine(doc, chunk, line - 1, fold) &&
+				JoinLexerState(plex, chunk, line);
+			block *= 2;
+		}
+		if (result.converged) {
+			CopyLines(doc, chunk, line, chunk.lineEnd, fold);
+		}
+		chunk.plex->Release();
+		results.push_back(result);
+	}
+	plex->Release();
+	return results;
+}
@@ -0,0 +1,42 @@
+// Lexilla lexer library
+/** @file ParallelLexer.h
+ ** Lex a BatchDocument with multiple threads.
+ ** The document is divided into chunks of lines and each chunk after the first is lexed
+ ** speculatively on a worker thread as if its text were a whole document. Lexers that
+ ** implement LEXILLA_PRIVATECALL_SPLITLINE move each chunk start to a line where lexing can
+ ** begin again, such as the start of an SQL statement.
+ ** The chunks are then joined in order by lexing each one again from its start until the
+ ** style at a line end, the line state, and, when folding, the fold level match the speculative
+ ** lex, after which the speculative results are copied.
+ ** Lexers that hold other state for each line must implement LEXILLA_PRIVATECALL_JOINSTATE to
+ ** check and take that state from the speculative lexer. Otherwise this is only correct for
+ ** lexers whose state between lines is fully held in the document so should not be used with
+ ** lexers that maintain other state such as the C++ lexer when preprocessor tracking is on.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef PARALLELLEXER_H
+#define PARALLELLEXER_H
+
+namespace Lexilla {
+
+// Create a lexer with properties and word lists set. Called once for each chunk.
+using LexerMaker = std::function<Scintilla::ILexer5 *()>;
+
+struct ChunkResult {
+	Sci_Position lineStart;
+	Sci_Position lineEnd;
+	// Lines lexed again when joining before the state matched the speculative lex.
+	// For a chunk that did not converge this is all of its lines.
+	Sci_Position linesRelexed;
+	bool converged;
+};
+
+// Lex the whole of doc with up to chunks threads, each chunk having at least minimumLines lines.
+// When fold is true, each chunk is also folded so doc must store fold levels.
+// Returns a result for each chunk which shows how quickly the lexer converged.
+std::vector<ChunkResult> LexParallel(BatchDocument &doc, const LexerMaker &maker, size_t chunks, Sci_Position minimumLines=1000, bool fold=false);
+
+}
+
+#endif
@@ -0,0 +1,202 @@
+// Lexilla lexer library
+/** @file StyleRunAdapter.cxx
+ ** Wrap an IDocument so that lexers send style runs.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <utility>
+#include <string>
+#include <string_view>
+#include <functional>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "StyleRunAdapter.h"
+
+using namespace Lexilla;
+
+namespace {
+
+// Same as the buffer in LexAccessor so SetStyles is called about as often as without the adapter.
+constexpr size_t bufferSize = 4000;
+
+}
+
+StyleRunAdapter::StyleRunAdapter(Scintilla::IDocument *pdoc_, RunReceiver receiver_) :
+	pdoc(pdoc_), receiver(std::move(receiver_)), position(0) {
+}
+
+StyleRunAdapter::~StyleRunAdapter() {
+	try {
+		Flush();
+	} catch (...) {
+		// Destructors must not throw so styles that could not be sent are lost
+	}
+}
+
+void StyleRunAdapter::Report(Sci_Position start, Sci_Position length, char style) {
+	if (receiver && (length > 0)) {
+		receiver(start, length, style);
+	}
+}
+
+void StyleRunAdapter::Flush() {
+	if (!styles.empty()) {
+		pdoc->SetStyles(styles.length(), styles.data());
+		styles.clear();
+	}
+}
+
+#if defined(_MSC_VER)
+// IDocument interface does not specify noexcept so best to not add it to implementation
+#pragma warning(disable: 26440)
+#endif
+
+int SCI_METHOD StyleRunAdapter::Version() const {
+	return dvStyleRuns;
+}
+
+void SCI_METHOD StyleRunAdapter::SetErrorStatus(int status) {
+	pdoc->SetErrorStatus(status);
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::Length() const {
+	return pdoc->Length();
+}
+
+void SCI_METHOD StyleRunAdapter::GetCharRange(char *buffer, Sci_Position position_, Sci_Position lengthRetrieve) const {
+	pdoc->GetCharRange(buffer, position_, lengthRetrieve);
+}
+
+char SCI_METHOD StyleRunAdapter::StyleAt(Sci_Position position_) const {
+	const Sci_Position index = position_ - (position - styles.length());
+	if ((index >= 0) && (index < static_cast<Sci_Position>(styles.length()))) {
+		return styles[index];
+	}
+	return pdoc->StyleAt(position_);
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::LineFromPosition(Sci_Position position_) const {
+	return pdoc->LineFromPosition(position_);
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::LineStart(Sci_Position line) const {
+	return pdoc->LineStart(line);
+}
+
+int SCI_METHOD StyleRunAdapter::GetLevel(Sci_Position line) const {
+	return pdoc->GetLevel(line);
+}
+
+int SCI_METHOD StyleRunAdapter::SetLevel(Sci_Position line, int level) {
+	return pdoc->SetLevel(line, level);
+}
+
+int SCI_METHOD StyleRunAdapter::GetLineState(Sci_Position line) const {
+	return pdoc->GetLineState(line);
+}
+
+int SCI_METHOD StyleRunAdapter::SetLineState(Sci_Position line, int state) {
+	return pdoc->SetLineState(line, state);
+}
+
+void SCI_METHOD StyleRunAdapter::StartStyling(Sci_Position position_) {
+	Flush();
+	pdoc->StartStyling(position_);
+	position = position_;
+}
+
+bool SCI_METHOD StyleRunAdapter::SetStyleFor(Sci_Position length, char style) {
+	Flush();
+	Report(position, length, style);
+	position += length;
+	return pdoc->SetStyleFor(length, style);
+}
+
+bool SCI_METHOD StyleRunAdapter::SetStyles(Sci_Position length, const char *styles_) {
+	Flush();
+	Sci_Position i = 0;
+	while (i < length) {
+		const char style = styles_[i];
+		Sci_Position end = i + 1;
+		while ((end < length) && (styles_[end] == style)) {
+			end++;
+		}
+		Report(position + i, end - i, style);
+		i = end;
+	}
+	position += length;
+	return pdoc->SetStyles(length, styles_);
+}
+
+void SCI_METHOD StyleRunAdapter::DecorationSetCurrentIndicator(int indicator) {
+	pdoc->DecorationSetCurrentIndicator(indicator);
+}
+
+void SCI_METHOD StyleRunAdapter::DecorationFillRange(Sci_Position position_, int value, Sci_Position fillLength) {
+	pdoc->DecorationFillRange(position_, value, fillLength);
+}
+
+void SCI_METHOD StyleRunAdapter::ChangeLexerState(Sci_Position start, Sci_Position end) {
+	pdoc->ChangeLexerState(start, end);
+}
+
+int SCI_METHOD StyleRunAdapter::CodePage() const {
+	return pdoc->CodePage();
+}
+
+bool SCI_METHOD StyleRunAdapter::IsDBCSLeadByte(char ch) const {
+	return pdoc->IsDBCSLeadByte(ch);
+}
+
+const char *SCI_METHOD StyleRunAdapter::BufferPointer() {
+	return pdoc->BufferPointer();
+}
+
+int SCI_METHOD StyleRunAdapter::GetLineIndentation(Sci_Position line) {
+	return pdoc->GetLineIndentation(line);
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::LineEnd(Sci_Position line) const {
+	return pdoc->LineEnd(line);
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const {
+	return pdoc->GetRelativePosition(positionStart, characterOffset);
+}
+
+int SCI_METHOD StyleRunAdapter::GetCharacterAndWidth(Sci_Position position_, Sci_Position *pWidth) const {
+	return pdoc->GetCharacterAndWidth(position_, pWidth);
+}
+
+void SCI_METHOD StyleRunAdapter::SetStyleRun(Sci_Position start, Sci_Position length, char style) {
+	if (start != position) {
+		StartStyling(start);
+	}
+	Report(start, length, style);
+	if (length >= static_cast<Sci_Position>(bufferSize)) {
+		// Too big for buffer so send directly
+		Flush();
+		pdoc->SetStyleFor(length, style);
+	} else {
+		if (styles.length() + length > bufferSize) {
+			Flush();
+		}
+		styles.append(length, style);
+	}
+	position = start + length;
+}
+
+Sci_Position SCI_METHOD StyleRunAdapter::StyleRunStart(Sci_Position position_) const {
+	// The wrapped document only provides a style for each position
+	if (position_ <= 0) {
+		return 0;
+	}
+	const char style = StyleAt(position_);
+	while ((position_ > 0) && (StyleAt(position_ - 1) == style)) {
+		position_--;
+	}
+	return position_;
+}
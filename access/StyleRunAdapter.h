@@ -0,0 +1,71 @@
+// Lexilla lexer library
+/** @file StyleRunAdapter.h
+ ** Wrap an IDocument so that lexers send style runs which are reported to the application
+ ** and also converted into calls to IDocument::SetStyles for the wrapped document.
+ ** This allows an application that calls ILexer5::Lex itself on a document that stores a style
+ ** for each position, such as a Scintilla-compatible document, to receive runs as well.
+ ** Call Flush after lexing so the last styles reach the wrapped document. Styles still held
+ ** when the adapter is destroyed are flushed then.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef STYLERUNADAPTER_H
+#define STYLERUNADAPTER_H
+
+namespace Lexilla {
+
+class StyleRunAdapter : public IDocumentStyleRuns {
+public:
+	using RunReceiver = std::function<void(Sci_Position start, Sci_Position length, char style)>;
+private:
+	Scintilla::IDocument *pdoc;
+	RunReceiver receiver;
+	// Styles not yet sent to pdoc which end at position.
+	std::string styles;
+	Sci_Position position;
+
+	void Report(Sci_Position start, Sci_Position length, char style);
+public:
+	explicit StyleRunAdapter(Scintilla::IDocument *pdoc_, RunReceiver receiver_={});
+	// Deleted so StyleRunAdapter objects can not be copied.
+	StyleRunAdapter(const StyleRunAdapter &) = delete;
+	StyleRunAdapter(StyleRunAdapter &&) = delete;
+	StyleRunAdapter &operator=(const StyleRunAdapter &) = delete;
+	StyleRunAdapter &operator=(StyleRunAdapter &&) = delete;
+	virtual ~StyleRunAdapter();
+
+	// Send styles held by the adapter to the wrapped document.
+	void Flush();
+
+	int SCI_METHOD Version() const override;
+	void SCI_METHOD SetErrorStatus(int status) override;
+	Sci_Position SCI_METHOD Length() const override;
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position_, Sci_Position lengthRetrieve) const override;
+	char SCI_METHOD StyleAt(Sci_Position position_) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position_) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position_) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles_) override;
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+	void SCI_METHOD DecorationFillRange(Sci_Position position_, int value, Sci_Position fillLength) override;
+	void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+	int SCI_METHOD CodePage() const override;
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+	const char *SCI_METHOD BufferPointer() override;
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position_, Sci_Position *pWidth) const override;
+
+	void SCI_METHOD SetStyleRun(Sci_Position start, Sci_Position length, char style) override;
+	Sci_Position SCI_METHOD StyleRunStart(Sci_Position position_) const override;
+};
+
+}
+
+#endif
@@ -78,6 +78,55 @@ typedef const char *(LEXILLA_CALL *GetNameSpaceFn)(void);
 #define LEXILLA_SETLIBRARYPROPERTY "SetLibraryProperty"
 #define LEXILLA_GETNAMESPACE "GetNameSpace"
 
+// Operations for ILexer5::PrivateCall that are implemented by some lexers.
+// Lexers return NULL for operations they do not implement.
+
+// Lex and fold a range in one pass with the folder following just behind the lexer, so text and
+// styles are read from the lexer's buffers instead of being retrieved again from the document.
+// The pointer is to a Lexilla::LexFoldRange and is returned when the operation is performed.
+#define LEXILLA_PRIVATECALL_LEXFOLD 0x4C580001
+
+// Save the state the lexer holds between calls to Lex, apart from properties and word lists,
+// so that it can be restored in another process. The pointer is to a Lexilla::LexerStateBuffer.
+// The length is set to the size of the state and, if data is not NULL and length was large
+// enough, the state is copied into data. Returns the pointer when the lexer can save its state.
+#define LEXILLA_PRIVATECALL_SAVESTATE 0x4C580002
+
+// Restore state saved with LEXILLA_PRIVATECALL_SAVESTATE by the same lexer. The pointer is to
+// a Lexilla::LexerStateBuffer and is returned when the state was valid and has been restored.
+#define LEXILLA_PRIVATECALL_RESTORESTATE 0x4C580003
+
+// Import preprocessor definitions, such as those found by scanning headers, that apply before
+// the word list of definitions. The pointer is to a NUL-terminated string with the same syntax
+// as that word list and is returned. Lexers importing the same text share one copy of the
+// definitions. A NULL or empty string removes imported definitions. The document should be
+// lexed again after importing.
+#define LEXILLA_PRIVATECALL_IMPORTDEFINITIONS 0x4C580004
+
+// Lex like ILexer5::Lex but stop at the start of a line once lexing is in text that has not
+// changed since this lexer last lexed it and the state carried into the line is the same as
+// then, as the rest of the range would be styled the same. The pointer is to a
+// Lexilla::LexConvergeRange and is returned when the lexer supports this.
+#define LEXILLA_PRIVATECALL_LEXCONVERGE 0x4C580005
+
+// Find a line where lexing and folding can start from the default style with no other state,
+// such as the start of a statement, so that text can be divided into chunks lexed separately.
+// The text need not have been lexed so the line is a guess that is checked by lexing. The
+// pointer is to a Lexilla::SplitLine and is returned when such a line was found.
+#define LEXILLA_PRIVATECALL_SPLITLINE 0x4C580006
+
+// Join the state held for each line by another lexer of the same type that lexed and folded
+// text starting at a line of this lexer's document. When the state held for the join line
+// is the same in both lexers, the state for later lines is taken from the other lexer. The
+// pointer is to a Lexilla::JoinState and is returned when the lexer holds state for each line.
+#define LEXILLA_PRIVATECALL_JOINSTATE 0x4C580007
+
+// Give a lexer that styles embedded languages with other lexers, such as the HTML lexer with
+// lexer.html.script.lexer, a function to create those lexers by name. The pointer is to a
+// Lexilla::CreateLexerFn, such as one pointing to CreateLexer, and is returned when the lexer
+// uses it. Call before setting properties.
+#define LEXILLA_PRIVATECALL_CREATELEXER 0x4C580008
+
 // Static linking prototypes
 
 #if defined(__cplusplus)
@@ -100,6 +149,60 @@ const char *LEXILLA_CALL GetNameSpace(void);
 #if defined(__cplusplus)
 namespace Lexilla {
 	class LexerModule;
+	// Arguments of ILexer5::Lex and ILexer5::Fold for LEXILLA_PRIVATECALL_LEXFOLD
+	struct LexFoldRange {
+		Sci_PositionU startPos;
+		Sci_Position lengthDoc;
+		int initStyle;
+		Scintilla::IDocument *pAccess;
+	};
+	// Arguments of ILexer5::Lex for LEXILLA_PRIVATECALL_LEXCONVERGE.
+	// The text from unchangedFrom, with its styles and line states, must be the same as when
+	// it was last lexed apart from moving with changes before it. Use -1 when nothing is known
+	// to be unchanged. linesMoved is the number of lines inserted before unchangedFrom since it
+	// was last lexed, negative when lines were deleted. end is set to where lexing stopped.
+	struct LexConvergeRange {
+		Sci_PositionU startPos;
+		Sci_Position lengthDoc;
+		int initStyle;
+		Scintilla::IDocument *pAccess;
+		Sci_Position unchangedFrom;
+		Sci_Position linesMoved;
+		Sci_Position end;
+	};
+	// Arguments for LEXILLA_PRIVATECALL_SPLITLINE. Lines from line up to lineEnd are examined
+	// and line is set to the line found.
+	struct SplitLine {
+		Scintilla::IDocument *pAccess;
+		Sci_Position line;
+		Sci_Position lineEnd;
+	};
+	// Arguments for LEXILLA_PRIVATECALL_JOINSTATE. Line 0 of other's document is lineOffset in
+	// this lexer's document and state is joined at line. joined is set when the states matched.
+	struct JoinState {
+		Scintilla::ILexer5 *other;
+		Sci_Position lineOffset;
+		Sci_Position line;
+		bool joined;
+	};
+	// Saved lexer state for LEXILLA_PRIVATECALL_SAVESTATE and LEXILLA_PRIVATECALL_RESTORESTATE
+	struct LexerStateBuffer {
+		char *data;
+		size_t length;
+	};
+	// IDocument::Version returns dvStyleRuns for documents that implement IDocumentStyleRuns
+	constexpr int dvStyleRuns = 0x4C580100;
+	// A document that stores styles as runs so lexers send each run directly instead of
+	// filling a buffer with a style for each position and calling SetStyles.
+	class IDocumentStyleRuns : public Scintilla::IDocument {
+	public:
+		// Set the style of [start, start+length). start follows the previous run unless
+		// StartStyling was called since then.
+		virtual void SCI_METHOD SetStyleRun(Sci_Position start, Sci_Position length, char style) = 0;
+		// Return the first position of the run of positions with the same style that ends at
+		// position so lexers can move back to where a style began without examining each position.
+		virtual Sci_Position SCI_METHOD StyleRunStart(Sci_Position position) const = 0;
+	};
 }
 // Add a static lexer (in the same binary) to Lexilla's list
 void AddStaticLexerModule(const Lexilla::LexerModule *plm);
@@ -16,6 +16,8 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <iterator>
 #include <initializer_list>
 #include <functional>
 
@@ -33,6 +35,7 @@
 #include "OptionSet.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "LineStacks.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -267,6 +270,18 @@ public:
 		Outer = outer;
 		State = state;
 	}
+	void Save(std::vector<int> &saved) const {
+		saved.insert(saved.end(), { Count, Up, Down, static_cast<int>(Style), Outer, static_cast<int>(State) });
+	}
+	const int *Restore(const int *saved) noexcept {
+		Count = saved[0];
+		Up = saved[1];
+		Down = saved[2];
+		Style = static_cast<QuoteStyle>(saved[3]);
+		Outer = saved[4];
+		State = static_cast<CmdState>(saved[5]);
+		return saved + 6;
+	}
 };
 
 class QuoteStackCls {	// Class to manage quote pairs that nest
@@ -333,6 +348,26 @@ public:
 		backtickLevel = 0;
 		Current.Clear();
 	}
+	// Append the whole stack to saved so that Restore can continue from it.
+	void Save(std::vector<int> &saved) const {
+		saved.insert(saved.end(), { Depth, State, lineContinuation, insideCommand, static_cast<int>(backtickLevel) });
+		for (int i = 0; i < Depth; i++) {
+			Stack[i].Save(saved);
+		}
+		Current.Save(saved);
+	}
+	const int *Restore(const int *saved) noexcept {
+		Depth = saved[0];
+		State = saved[1];
+		lineContinuation = saved[2] != 0;
+		insideCommand = saved[3];
+		backtickLevel = saved[4];
+		saved += 5;
+		for (int i = 0; i < Depth; i++) {
+			saved = Stack[i].Restore(saved);
+		}
+		return Current.Restore(saved);
+	}
 	bool CountDown(StyleContext &sc, CmdState &cmdState) {
 		Current.Count--;
 		while (Current.Count > 0 && sc.chNext == Current.Down) {
@@ -484,6 +519,9 @@ class LexerBash final : public DefaultLexer {
 	CharacterSet setParamStart;
 	enum { ssIdentifier, ssScalar };
 	SubStyles subStyles{styleSubable};
+	// For each line that does not start a new command, the state entering it: the style,
+	// CmdState, QuoteStackCls and here document serialized by their Save methods.
+	LineStacks<int> statesAtLineStart;
 public:
 	LexerBash() :
 		DefaultLexer("bash", SCLEX_BASH, lexicalClasses, std::size(lexicalClasses)),
@@ -619,6 +657,21 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 			Delimiter[DelimiterLength++] = static_cast<char>(ch);
 			Delimiter[DelimiterLength] = '\0';
 		}
+		void Save(std::vector<int> &saved) const {
+			saved.insert(saved.end(), { State, Quote, Quoted, Escaped, Indent, BackslashCount, DelimiterLength });
+			saved.insert(saved.end(), Delimiter, Delimiter + DelimiterLength);
+		}
+		void Restore(const int *saved) noexcept {
+			State = saved[0];
+			Quote = saved[1];
+			Quoted = saved[2] != 0;
+			Escaped = saved[3] != 0;
+			Indent = saved[4] != 0;
+			BackslashCount = saved[5];
+			DelimiterLength = saved[6];
+			std::copy(saved + 7, saved + 7 + DelimiterLength, Delimiter);
+			Delimiter[DelimiterLength] = '\0';
+		}
 	};
 	HereDocCls HereDoc;
 
@@ -634,39 +687,56 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 	const Sci_PositionU endPos = startPos + length;
 	CmdState cmdState = CmdState::Start;
 	LexAccessor styler(pAccess);
+	std::vector<int> lineStartState;
 
-	// Always backtracks to the start of a line that is not a continuation
-	// of the previous line (i.e. start of a bash command segment)
+	// Start at the line containing startPos when the state entering it is known: either it
+	// starts a bash command segment or its state was saved. Otherwise backtrack to such a line.
 	Sci_Position ln = styler.GetLine(startPos);
-	if (ln > 0 && startPos == static_cast<Sci_PositionU>(styler.LineStart(ln)))
-		ln--;
-	for (;;) {
-		startPos = styler.LineStart(ln);
-		if (ln == 0 || styler.GetLineState(ln) == static_cast<int>(CmdState::Start))
+	initStyle = SCE_SH_DEFAULT;
+	while (ln > 0 && styler.GetLineState(ln) != static_cast<int>(CmdState::Start)) {
+		if (statesAtLineStart.Get(ln, lineStartState)) {
+			initStyle = lineStartState[0];
+			cmdState = static_cast<CmdState>(lineStartState[1]);
+			HereDoc.Restore(QuoteStack.Restore(lineStartState.data() + 2));
 			break;
+		}
 		ln--;
 	}
-	initStyle = SCE_SH_DEFAULT;
+	startPos = styler.LineStart(ln);
 
 	StyleContext sc(startPos, endPos - startPos, initStyle, styler);
 
+	// handle line continuation, updates per-line stored state
+	auto enterLine = [&]() {
+		const CmdState cmdStateEnter = cmdState;
+		CmdState state = CmdState::Body;	// line does not start a command segment
+		if (!StyleForceBacktrack(MaskCommand(sc.state))) {
+			// retain last line's state
+			// arithmetic expression and double bracket test can span multiline without line continuation
+			if (!QuoteStack.lineContinuation && !AnyOf(cmdState, CmdState::DoubleBracket, CmdState::Arithmetic)) {
+				cmdState = CmdState::Start;
+			}
+			if (QuoteStack.Empty()) {
+				state = cmdState;
+			}
+		}
+		if (state == CmdState::Start) {
+			statesAtLineStart.Truncate(sc.currentLine);
+		} else {
+			// save the state before it was updated above so lexing can restart from this line
+			lineStartState.assign({ sc.state, static_cast<int>(cmdStateEnter) });
+			QuoteStack.Save(lineStartState);
+			HereDoc.Save(lineStartState);
+			statesAtLineStart.Set(sc.currentLine, lineStartState);
+		}
+		QuoteStack.lineContinuation = false;
+		styler.SetLineState(sc.currentLine, static_cast<int>(state));
+	};
+
 	while (sc.More()) {
 
-		// handle line continuation, updates per-line stored state
 		if (sc.atLineStart) {
-			CmdState state = CmdState::Body;	// force backtrack while retaining cmdState
-			if (!StyleForceBacktrack(MaskCommand(sc.state))) {
-				// retain last line's state
-				// arithmetic expression and double bracket test can span multiline without line continuation
-				if (!QuoteStack.lineContinuation && !AnyOf(cmdState, CmdState::DoubleBracket, CmdState::Arithmetic)) {
-					cmdState = CmdState::Start;
-				}
-				if (QuoteStack.Empty()) {	// force backtrack when nesting
-					state = cmdState;
-				}
-			}
-			QuoteStack.lineContinuation = false;
-			styler.SetLineState(sc.currentLine, static_cast<int>(state));
+			enterLine();
 		}
 
 		// controls change of cmdState at the end of a non-whitespace element
@@ -1176,6 +1246,10 @@ void SCI_METHOD LexerBash::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 		sc.Forward();
 	}
+	if (sc.atLineStart) {
+		// a later call may start at this line
+		enterLine();
+	}
 	sc.Complete();
 	if (MaskCommand(sc.state) == SCE_SH_HERE_Q) {
 		styler.ChangeLexerState(sc.currentPos, styler.Length());
@@ -9,19 +9,25 @@
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
+#include <cstdint>
 
 #include <utility>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <optional>
 #include <algorithm>
 #include <iterator>
 #include <functional>
+#include <memory>
+#include <mutex>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 
 #include "StringCopy.h"
 #include "WordList.h"
@@ -33,6 +39,11 @@
 #include "OptionSet.h"
 #include "SparseState.h"
 #include "SubStyles.h"
+#include "LexFoldFusion.h"
+#include "LexConvergence.h"
+#include "StateStream.h"
+#include "LineStacks.h"
+#include "Preprocessor.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -226,99 +237,9 @@ constexpr bool IsStreamCommentStyle(int style) noexcept {
 		style == SCE_C_COMMENTDOCKEYWORDERROR;
 }
 
-struct PPDefinition {
-	Sci_Position line;
-	std::string key;
-	std::string value;
-	bool isUndef;
-	std::string arguments;
-	PPDefinition(Sci_Position line_, std::string_view key_, std::string_view value_, bool isUndef_, std::string_view arguments_) :
-		line(line_), key(key_), value(value_), isUndef(isUndef_), arguments(arguments_) {
-	}
-};
-
 constexpr int inactiveFlag = 0x40;
 
-class LinePPState {
-	// Track the state of preprocessor conditionals to allow showing active and inactive
-	// code in different styles.
-	// Only works up to 31 levels of conditional nesting.
-
-	// state is a bit mask with 1 bit per level
-	// bit is 1 for level if section inactive, so any bits set = inactive style
-	int state = 0;
-	// ifTaken is a bit mask with 1 bit per level
-	// bit is 1 for level if some branch at this level has been taken
-	int ifTaken = 0;
-	// level is the nesting level of #if constructs
-	int level = -1;
-	static const int maximumNestingLevel = 31;
-	[[nodiscard]] int maskLevel() const noexcept {
-		if (level >= 0) {
-			return 1 << level;
-		}
-		return 1;
-	}
-public:
-	LinePPState() noexcept = default;
-	[[nodiscard]] bool ValidLevel() const noexcept {
-		return level >= 0 && level < maximumNestingLevel;
-	}
-	[[nodiscard]] bool IsActive() const noexcept {
-		return state == 0;
-	}
-	[[nodiscard]] bool IsInactive() const noexcept {
-		return state != 0;
-	}
-	[[nodiscard]] int ActiveState() const noexcept {
-		return state ? inactiveFlag : 0;
-	}
-	[[nodiscard]] bool CurrentIfTaken() const noexcept {
-		return (ifTaken & maskLevel()) != 0;
-	}
-	void StartSection(bool on) noexcept {
-		level++;
-		if (ValidLevel()) {
-			if (on) {
-				state &= ~maskLevel();
-				ifTaken |= maskLevel();
-			} else {
-				state |= maskLevel();
-				ifTaken &= ~maskLevel();
-			}
-		}
-	}
-	void EndSection() noexcept {
-		if (ValidLevel()) {
-			state &= ~maskLevel();
-			ifTaken &= ~maskLevel();
-		}
-		level--;
-	}
-	void InvertCurrentLevel() noexcept {
-		if (ValidLevel()) {
-			state ^= maskLevel();
-			ifTaken |= maskLevel();
-		}
-	}
-};
-
-// Hold the preprocessor state for each line seen.
-// Currently one entry per line but could become sparse with just one entry per preprocessor line.
-class PPStates {
-	std::vector<LinePPState> vlls;
-public:
-	[[nodiscard]] LinePPState ForLine(Sci_Position line) const noexcept {
-		if ((line > 0) && (vlls.size() > static_cast<size_t>(line))) {
-			return vlls[line];
-		}
-		return {};
-	}
-	void Add(Sci_Position line, LinePPState lls) {
-		vlls.resize(line+1);
-		vlls[line] = lls;
-	}
-};
+using PPLineState = LinePPState<inactiveFlag>;
 
 enum class BackQuotedString : int {
 	None,
@@ -541,36 +462,22 @@ class LexerCPP : public ILexer5 {
 	CharacterSet setRelOp;
 	CharacterSet setLogicalOp;
 	CharacterSet setWordStart;
-	PPStates vlls;
-	std::vector<PPDefinition> ppDefineHistory;
-	std::map<Sci_Position, std::vector<InterpolatingState>> interpolatingAtEol;
+	PPStates<PPLineState> vlls;
+	PPDefinitions ppDefineHistory;
+	LineStacks<InterpolatingState> interpolatingAtEol;
 	WordList keywords;
 	WordList keywords2;
 	WordList keywords3;
 	WordList keywords4;
 	WordList ppDefinitions;
 	WordList markerList;
-	struct SymbolValue {
-		std::string value;
-		std::string arguments;
-		SymbolValue() noexcept = default;
-		SymbolValue(std::string_view value_, std::string_view arguments_) : value(value_), arguments(arguments_) {
-		}
-		SymbolValue &operator = (const std::string &value_) {
-			value = value_;
-			arguments.clear();
-			return *this;
-		}
-		[[nodiscard]] bool IsMacro() const noexcept {
-			return !arguments.empty();
-		}
-	};
-	using SymbolTable = std::map<std::string, SymbolValue>;
-	SymbolTable preprocessorDefinitionsStart;
+	PPExpressionCache<Tokens> expressionCache;
 	OptionsCPP options;
 	OptionSetCPP osCPP;
 	EscapeSequence escapeSeq;
 	SparseState<std::string> rawStringTerminators;
+	LexFoldFusion fusion;
+	LexConvergence convergence;
 	enum { ssIdentifier, ssDocKeyword };
 	SubStyles subStyles{ styleSubable, SubStylesFirst, SubStylesAvailable, inactiveFlag };
 	std::string returnBuffer;
@@ -613,8 +520,33 @@ public:
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 
-	void *SCI_METHOD PrivateCall(int, void *) noexcept override {
-		return nullptr;
+	void *SaveState(void *pointer) const;
+	void *RestoreState(void *pointer);
+	static std::shared_ptr<const SymbolTable> SharedDefinitions(const char *text);
+	void *ImportDefinitions(void *pointer);
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) noexcept override {
+		// Failures, such as running out of memory, are treated as the operation not being performed
+		try {
+			return PerformPrivateCall(operation, pointer);
+		} catch (...) {
+			return nullptr;
+		}
+	}
+	void *PerformPrivateCall(int operation, void *pointer) {
+		switch (operation) {
+		case LEXILLA_PRIVATECALL_LEXFOLD:
+			return fusion.LexFold(this, pointer);
+		case LEXILLA_PRIVATECALL_SAVESTATE:
+			return SaveState(pointer);
+		case LEXILLA_PRIVATECALL_RESTORESTATE:
+			return RestoreState(pointer);
+		case LEXILLA_PRIVATECALL_IMPORTDEFINITIONS:
+			return ImportDefinitions(pointer);
+		case LEXILLA_PRIVATECALL_LEXCONVERGE:
+			return convergence.LexConverge(this, pointer);
+		default:
+			return nullptr;
+		}
 	}
 
 	int SCI_METHOD LineEndTypesSupported() noexcept override {
@@ -722,9 +654,9 @@ public:
 	constexpr static int MaskActive(int style) noexcept {
 		return style & ~inactiveFlag;
 	}
-	void EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDefinitions);
+	void EvaluateTokens(Tokens &tokens, const SymbolScope &preprocessorDefinitions);
 	[[nodiscard]] Tokens Tokenize(const std::string &expr) const;
-	bool EvaluateExpression(const std::string &expr, const SymbolTable &preprocessorDefinitions);
+	bool EvaluateExpression(const std::string &expr, const SymbolScope &preprocessorDefinitions);
 };
 
 Sci_Position SCI_METHOD LexerCPP::PropertySet(const char *key, const char *val) {
@@ -734,6 +666,7 @@ Sci_Position SCI_METHOD LexerCPP::PropertySet(const char *key, const char *val)
 			if (options.identifiersAllowDollars) {
 				setWord.Add('$');
 			}
+			expressionCache.Clear();
 		}
 		return 0;
 	}
@@ -774,17 +707,288 @@ Sci_Position SCI_METHOD LexerCPP::WordListSet(int n, const char *wl) {
 			firstModification = 0;
 			if (n == 4) {
 				// Rebuild preprocessorDefinitions
-				preprocessorDefinitionsStart.clear();
+				std::shared_ptr<SymbolChanges> definitionsStart = std::make_shared<SymbolChanges>();
 				for (int nDefinition = 0; nDefinition < ppDefinitions.Length(); nDefinition++) {
 					const Definition def = ParseDefine(ppDefinitions.WordAt(nDefinition), "(=");
-					preprocessorDefinitionsStart[std::string(def.name)] = SymbolValue(def.value, def.arguments);
+					(*definitionsStart)[std::string(def.name)] = SymbolValue(def.value, def.arguments);
 				}
+				ppDefineHistory.SetStart(definitionsStart);
 			}
 		}
 	}
 	return firstModification;
 }
 
+std::shared_ptr<const SymbolTable> LexerCPP::SharedDefinitions(const char *text) {
+	// Tables are only kept while some lexer uses them. They are found by the hash and length
+	// of their text and, as the text is not kept, the tables are compared when both match.
+	using HashAndLength = std::pair<size_t, size_t>;
+	static std::mutex mutexShared;
+	static std::multimap<HashAndLength, std::weak_ptr<const SymbolTable>> sharedDefinitions;
+	const std::string_view textView(text);
+	const HashAndLength key(std::hash<std::string_view>{}(textView), textView.length());
+
+	std::shared_ptr<SymbolTable> imported = std::make_shared<SymbolTable>();
+	WordList wlDefinitions;
+	wlDefinitions.Set(text);
+	for (int nDefinition = 0; nDefinition < wlDefinitions.Length(); nDefinition++) {
+		const Definition def = ParseDefine(wlDefinitions.WordAt(nDefinition), "(=");
+		(*imported)[std::string(def.name)] = SymbolValue(def.value, def.arguments);
+	}
+
+	const std::lock_guard<std::mutex> guard(mutexShared);
+	const auto [first, last] = sharedDefinitions.equal_range(key);
+	for (auto it = first; it != last; ++it) {
+		std::shared_ptr<const SymbolTable> shared = it->second.lock();
+		if (shared && (*shared == *imported)) {
+			return shared;
+		}
+	}
+	for (auto it = sharedDefinitions.begin(); it != sharedDefinitions.end();) {
+		if (it->second.expired()) {
+			it = sharedDefinitions.erase(it);
+		} else {
+			++it;
+		}
+	}
+	sharedDefinitions.emplace(key, imported);
+	return imported;
+}
+
+void *LexerCPP::ImportDefinitions(void *pointer) {
+	const char *text = static_cast<const char *>(pointer);
+	if (text && *text) {
+		ppDefineHistory.Import(SharedDefinitions(text));
+	} else {
+		ppDefineHistory.Import({});
+	}
+	return pointer;
+}
+
+// Increment when the layout of saved state changes
+constexpr int stateVersionCPP = 2;
+
+void *LexerCPP::SaveState(void *pointer) const {
+	StateWriter writer;
+	writer.Header("cpp", stateVersionCPP);
+	vlls.Write(writer);
+	writer.Number(ppDefineHistory.Count());
+	for (const PPDefinition &ppDef : ppDefineHistory.History()) {
+		writer.Number(ppDef.line);
+		writer.String(ppDef.key);
+		writer.String(ppDef.value);
+		writer.Number(ppDef.isUndef);
+		writer.String(ppDef.arguments);
+	}
+	writer.Number(rawStringTerminators.size());
+	for (size_t i = 0; i < rawStringTerminators.size(); i++) {
+		writer.Number(rawStringTerminators.PositionOfIndex(i));
+		writer.String(rawStringTerminators.ValueOfIndex(i));
+	}
+	writer.Number(interpolatingAtEol.Count());
+	for (size_t i = 0; i < interpolatingAtEol.Count(); i++) {
+		writer.Number(interpolatingAtEol.Line(i));
+		writer.Number(interpolatingAtEol.Depth(i));
+		const InterpolatingState *stack = interpolatingAtEol.Bottom(i);
+		for (size_t j = 0; j < interpolatingAtEol.Depth(i); j++) {
+			writer.Number(stack[j].state);
+			writer.Number(stack[j].braceCount);
+		}
+	}
+	return writer.CopyTo(pointer);
+}
+
+void *LexerCPP::RestoreState(void *pointer) {
+	StateReader reader(pointer);
+	if (!reader.Header("cpp", stateVersionCPP)) {
+		return nullptr;
+	}
+	// Read into new variables so nothing changes if the state is malformed
+	PPStates<PPLineState> vllsRead;
+	vllsRead.Read(reader);
+	std::vector<PPDefinition> ppDefineHistoryRead;
+	const size_t definitions = reader.Count();
+	for (size_t i = 0; i < definitions; i++) {
+		const Sci_Position line = reader.Number();
+		const std::string key = reader.String();
+		const std::string value = reader.String();
+		const bool isUndef = reader.Number() != 0;
+		const std::string arguments = reader.String();
+		ppDefineHistoryRead.emplace_back(line, key, value, isUndef, arguments);
+	}
+	SparseState<std::string> rawStringTerminatorsRead;
+	const size_t terminators = reader.Count();
+	for (size_t i = 0; i < terminators; i++) {
+		const Sci_Position line = reader.Number();
+		rawStringTerminatorsRead.Set(line, reader.String());
+	}
+	LineStacks<InterpolatingState> interpolatingAtEolRead;
+	std::vector<InterpolatingState> stack;
+	const size_t interpolatingLines = reader.Count();
+	for (size_t i = 0; i < interpolatingLines; i++) {
+		const Sci_Position line = reader.Number();
+		const size_t depth = reader.Count();
+		stack.clear();
+		for (size_t j = 0; j < depth; j++) {
+			const int state = static_cast<int>(reader.Number());
+			const int braceCount = static_cast<int>(reader.Number());
+			stack.push_back({ state, braceCount });
+		}
+		interpolatingAtEolRead.Set(line, stack);
+	}
+	if (!reader.Complete()) {
+		return nullptr;
+	}
+	vlls = std::move(vllsRead);
+	ppDefineHistory.SetHistory(std::move(ppDefineHistoryRead));
+	rawStringTerminators = std::move(rawStringTerminatorsRead);
+	interpolatingAtEol = std::move(interpolatingAtEolRead);
+	return pointer;
+}
+
+// Store both the current line's fold level and the next lines in the
+// level store to make it easy to pick up with each increment
+// and to make it possible to fiddle the current level for "} else {".
+
+// Fold state kept between steps so that folding can follow just behind lexing.
+class FolderCPP {
+	const OptionsCPP &options;
+	const Sci_PositionU startPos;
+	const Sci_PositionU endPos;
+	Sci_PositionU position;
+	int visibleChars = 0;
+	bool inLineComment = false;
+	Sci_Position lineCurrent;
+	int levelCurrent = SC_FOLDLEVELBASE;
+	Sci_PositionU lineStartNext;
+	int levelMinCurrent;
+	int levelNext;
+	char chNext = 0;
+	int styleNext = 0;
+	int style;
+	const bool userDefinedFoldMarkers;
+public:
+	FolderCPP(const OptionsCPP &options_, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle);
+	// Fold each position before styled - 1 as it and the position after it have been styled.
+	void FoldTo(LexAccessor &styler, Sci_PositionU styled);
+};
+
+FolderCPP::FolderCPP(const OptionsCPP &options_, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle) :
+	options(options_),
+	startPos(startPos_),
+	endPos(startPos_ + length),
+	position(startPos_),
+	lineCurrent(styler.GetLine(startPos_)),
+	style(LexerCPP::MaskActive(initStyle)),
+	userDefinedFoldMarkers(!options_.foldExplicitStart.empty() && !options_.foldExplicitEnd.empty()) {
+	if (lineCurrent > 0)
+		levelCurrent = styler.LevelAt(lineCurrent-1) >> 16;
+	lineStartNext = styler.LineStart(lineCurrent+1);
+	levelMinCurrent = levelCurrent;
+	levelNext = levelCurrent;
+}
+
+void FolderCPP::FoldTo(LexAccessor &styler, Sci_PositionU styled) {
+	for (; (position < endPos) && (position + 1 < styled); position++) {
+		const Sci_PositionU i = position;
+		if (i == startPos) {
+			chNext = styler[startPos];
+			styleNext = LexerCPP::MaskActive(styler.BufferStyleAt(startPos));
+		}
+		const char ch = chNext;
+		chNext = styler.SafeGetCharAt(i + 1);
+		const int stylePrev = style;
+		style = styleNext;
+		styleNext = LexerCPP::MaskActive(styler.BufferStyleAt(i + 1));
+		const bool atEOL = i == (lineStartNext-1);
+		if ((style == SCE_C_COMMENTLINE) || (style == SCE_C_COMMENTLINEDOC))
+			inLineComment = true;
+		if (options.foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
+			if (!IsStreamCommentStyle(stylePrev)) {
+				levelNext++;
+			} else if (!IsStreamCommentStyle(styleNext) && !atEOL) {
+				// Comments don't end at end of line and the next character may be unstyled.
+				levelNext--;
+			}
+		}
+		if (options.foldComment && options.foldCommentExplicit && ((style == SCE_C_COMMENTLINE) || options.foldExplicitAnywhere)) {
+			if (userDefinedFoldMarkers) {
+				if (styler.Match(i, options.foldExplicitStart.c_str())) {
+					levelNext++;
+				} else if (styler.Match(i, options.foldExplicitEnd.c_str())) {
+					levelNext--;
+				}
+			} else {
+				if ((ch == '/') && (chNext == '/')) {
+					const char chNext2 = styler.SafeGetCharAt(i + 2);
+					if (chNext2 == '{') {
+						levelNext++;
+					} else if (chNext2 == '}') {
+						levelNext--;
+					}
+				}
+			}
+		}
+		if (options.foldPreprocessor && (style == SCE_C_PREPROCESSOR)) {
+			if (ch == '#') {
+				Sci_PositionU j = i + 1;
+				while ((j < endPos) && IsASpaceOrTab(styler.SafeGetCharAt(j))) {
+					j++;
+				}
+				if (styler.Match(j, "region") || styler.Match(j, "if")) {
+					levelNext++;
+				} else if (styler.Match(j, "end")) {
+					levelNext--;
+				}
+
+				if (options.foldPreprocessorAtElse && (styler.Match(j, "else") || styler.Match(j, "elif"))) {
+					levelMinCurrent--;
+				}
+			}
+		}
+		if (options.foldSyntaxBased && (style == SCE_C_OPERATOR)) {
+			if (ch == '{' || ch == '[' || ch == '(') {
+				// Measure the minimum before a '{' to allow
+				// folding on "} else {"
+				if (options.foldAtElse && levelMinCurrent > levelNext) {
+					levelMinCurrent = levelNext;
+				}
+				levelNext++;
+			} else if (ch == '}' || ch == ']' || ch == ')') {
+				levelNext--;
+			}
+		}
+		if (!IsASpace(ch))
+			visibleChars++;
+		if (atEOL || (i == endPos-1)) {
+			int levelUse = levelCurrent;
+			if ((options.foldSyntaxBased && options.foldAtElse) ||
+				(options.foldPreprocessor && options.foldPreprocessorAtElse)
+			) {
+				levelUse = levelMinCurrent;
+			}
+			int lev = levelUse | levelNext << 16;
+			if (visibleChars == 0 && options.foldCompact)
+				lev |= SC_FOLDLEVELWHITEFLAG;
+			if (levelUse < levelNext)
+				lev |= SC_FOLDLEVELHEADERFLAG;
+			if (lev != styler.LevelAt(lineCurrent)) {
+				styler.SetLevel(lineCurrent, lev);
+			}
+			lineCurrent++;
+			lineStartNext = styler.LineStart(lineCurrent+1);
+			levelCurrent = levelNext;
+			levelMinCurrent = levelCurrent;
+			if (atEOL && (i == static_cast<Sci_PositionU>(styler.Length()-1))) {
+				// There is an empty line at end of file so give it same level and empty
+				styler.SetLevel(lineCurrent, (levelCurrent | levelCurrent << 16) | SC_FOLDLEVELWHITEFLAG);
+			}
+			visibleChars = 0;
+			inLineComment = false;
+		}
+	}
+}
+
 void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 	LexAccessor styler(pAccess);
 
@@ -818,16 +1022,18 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 	std::vector<InterpolatingState> interpolatingStack;
 
 	Sci_Position lineCurrent = styler.GetLine(startPos);
+
+	// Lexing can only stop early when no interpolations are stored for later lines as they
+	// would be forgotten when this line is lexed. Preprocessor states and definitions of later
+	// lines are moved aside and raw string terminators are only replaced at the end so they can be kept.
+	const bool canConverge = convergence.Active() &&
+		((interpolatingAtEol.Count() == 0) ||
+			(interpolatingAtEol.Line(interpolatingAtEol.Count() - 1) < lineCurrent));
+
 	if (options.backQuotedStrings == BackQuotedString::TemplateLiteral) {
 		// code copied from LexPython
-		auto it = interpolatingAtEol.find(lineCurrent - 1);
-		if (it != interpolatingAtEol.end()) {
-			interpolatingStack = it->second;
-		}
-		it = interpolatingAtEol.lower_bound(lineCurrent);
-		if (it != interpolatingAtEol.end()) {
-			interpolatingAtEol.erase(it, interpolatingAtEol.end());
-		}
+		interpolatingAtEol.Get(lineCurrent - 1, interpolatingStack);
+		interpolatingAtEol.Truncate(lineCurrent);
 	}
 
 	if ((MaskActive(initStyle) == SCE_C_PREPROCESSOR) ||
@@ -852,31 +1058,33 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 		}
 	}
 
+	std::optional<FolderCPP> folder;
+	if (fusion.Active() && options.fold) {
+		folder.emplace(options, styler, startPos, length, initStyle);
+	}
+
 	StyleContext sc(startPos, length, initStyle, styler);
-	LinePPState preproc = vlls.ForLine(lineCurrent);
+	const Sci_Position lineStart = lineCurrent;
+	PPLineState preproc = vlls.ForLine(lineCurrent);
+	PPStates<PPLineState> vllsBefore = canConverge ? vlls.Split(lineCurrent) : PPStates<PPLineState>();
 
 	bool definitionsChanged = false;
 
 	// Truncate ppDefineHistory before current line
 
 	if (!options.updatePreprocessor)
-		ppDefineHistory.clear();
+		ppDefineHistory.Clear();
 
-	const std::vector<PPDefinition>::iterator itInvalid = std::find_if(
-		ppDefineHistory.begin(), ppDefineHistory.end(),
-		[lineCurrent](const PPDefinition &p) noexcept { return p.line >= lineCurrent; });
-	if (itInvalid != ppDefineHistory.end()) {
-		ppDefineHistory.erase(itInvalid, ppDefineHistory.end());
+	std::vector<PPDefinition> definitionsBefore;
+	if (canConverge) {
+		definitionsBefore = ppDefineHistory.Split(lineCurrent);
+		definitionsChanged = !definitionsBefore.empty();
+	} else if (ppDefineHistory.Truncate(lineCurrent)) {
 		definitionsChanged = true;
 	}
+	const size_t definitionsStart = ppDefineHistory.Count();
 
-	SymbolTable preprocessorDefinitions = preprocessorDefinitionsStart;
-	for (const PPDefinition &ppDef : ppDefineHistory) {
-		if (ppDef.isUndef)
-			preprocessorDefinitions.erase(ppDef.key);
-		else
-			preprocessorDefinitions[ppDef.key] = SymbolValue(ppDef.value, ppDef.arguments);
-	}
+	SymbolScope preprocessorDefinitions = ppDefineHistory.Scope();
 
 	std::string rawStringTerminator = rawStringTerminators.ValueAt(lineCurrent-1);
 	SparseState<std::string> rawSTNew(lineCurrent);
@@ -898,7 +1106,31 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 
 	for (; sc.More();) {
 
+		if (canConverge && sc.atLineStart) {
+			// Style the previous line end then stop if the state is the same as before
+			sc.SetState(sc.state);
+			const Sci_Position lineBefore = convergence.LineBefore(sc.currentLine);
+			const bool sameOther = (preproc == vllsBefore.ForLine(lineBefore)) &&
+				ppDefineHistory.SameSince(definitionsStart, definitionsBefore, lineBefore) &&
+				(rawStringTerminator == rawStringTerminators.ValueAt(lineBefore - 1)) && interpolatingStack.empty();
+			if (convergence.AtLineStart(styler, sc.currentLine, sameOther)) {
+				vlls.Resume(std::move(vllsBefore), sc.currentLine, lineBefore);
+				ppDefineHistory.Resume(std::move(definitionsBefore), sc.currentLine, lineBefore);
+				definitionsChanged = false;
+				for (size_t i = 0; i < rawStringTerminators.size(); i++) {
+					const Sci_Position lineTerminator = rawStringTerminators.PositionOfIndex(i);
+					if (lineTerminator >= lineBefore) {
+						rawSTNew.Set(lineTerminator + sc.currentLine - lineBefore, rawStringTerminators.ValueOfIndex(i));
+					}
+				}
+				break;
+			}
+		}
+
 		if (sc.atLineStart) {
+			if (folder) {
+				folder->FoldTo(styler, styler.GetStartSegment());
+			}
 			// Using MaskActive() is not needed in the following statement.
 			// Inside inactive preprocessor declaration, state will be reset anyway at the end of this block.
 			if ((sc.state == SCE_C_STRING) || (sc.state == SCE_C_CHARACTER)) {
@@ -929,7 +1161,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 				rawSTNew.Set(lineCurrent-1, rawStringTerminator);
 			}
 			if (!interpolatingStack.empty()) {
-				interpolatingAtEol[sc.currentLine] = interpolatingStack;
+				interpolatingAtEol.Set(sc.currentLine, interpolatingStack);
 			}
 		}
 
@@ -1369,7 +1601,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 							const bool isIfDef = sc.Match("ifdef");
 							const int startRest = isIfDef ? 5 : 6;
 							const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + startRest + 1, false);
-							const bool foundDef = preprocessorDefinitions.find(restOfLine) != preprocessorDefinitions.end();
+							const bool foundDef = preprocessorDefinitions.Find(restOfLine) != nullptr;
 							preproc.StartSection(isIfDef == foundDef);
 						} else if (sc.Match("if")) {
 							const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + 2, true);
@@ -1429,8 +1661,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 							if (options.updatePreprocessor && preproc.IsActive()) {
 								const std::string restOfLine = GetRestOfLine(styler, sc.currentPos + 6, true);
 								const Definition def = ParseDefine(restOfLine, "( \t");
-								preprocessorDefinitions[std::string(def.name)] = SymbolValue(def.value, def.arguments);
-								ppDefineHistory.emplace_back(lineCurrent, def.name, def.value, false, def.arguments);
+								ppDefineHistory.Add(preprocessorDefinitions, lineCurrent, def.name, def.value, false, def.arguments);
 								definitionsChanged = true;
 							}
 						} else if (sc.Match("undef")) {
@@ -1439,8 +1670,7 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 								Tokens tokens = Tokenize(restOfLine);
 								if (!tokens.empty()) {
 									const std::string key = tokens[0];
-									preprocessorDefinitions.erase(key);
-									ppDefineHistory.emplace_back(lineCurrent, key, "", true, "");
+									ppDefineHistory.Add(preprocessorDefinitions, lineCurrent, key, "", true, "");
 									definitionsChanged = true;
 								}
 							}
@@ -1479,133 +1709,31 @@ void SCI_METHOD LexerCPP::Lex(Sci_PositionU startPos, Sci_Position length, int i
 		continuationLine = false;
 		sc.Forward();
 	}
+	if (lineCurrent == lineStart) {
+		// No line end was reached so nothing replaced the states of later lines
+		vlls.Resume(std::move(vllsBefore), lineCurrent, lineCurrent);
+	}
 	const bool rawStringsChanged = rawStringTerminators.Merge(rawSTNew, lineCurrent);
 	if (definitionsChanged || rawStringsChanged)
 		styler.ChangeLexerState(startPos, startPos + length);
 	sc.Complete();
+	if (folder) {
+		folder->FoldTo(styler, styler.Length() + 1);
+	}
 }
 
-// Store both the current line's fold level and the next lines in the
-// level store to make it easy to pick up with each increment
-// and to make it possible to fiddle the current level for "} else {".
-
 void SCI_METHOD LexerCPP::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 
 	if (!options.fold)
 		return;
 
 	LexAccessor styler(pAccess);
-
-	const Sci_PositionU endPos = startPos + length;
-	int visibleChars = 0;
-	bool inLineComment = false;
-	Sci_Position lineCurrent = styler.GetLine(startPos);
-	int levelCurrent = SC_FOLDLEVELBASE;
-	if (lineCurrent > 0)
-		levelCurrent = styler.LevelAt(lineCurrent-1) >> 16;
-	Sci_PositionU lineStartNext = styler.LineStart(lineCurrent+1);
-	int levelMinCurrent = levelCurrent;
-	int levelNext = levelCurrent;
-	char chNext = styler[startPos];
-	int styleNext = MaskActive(styler.StyleAt(startPos));
-	int style = MaskActive(initStyle);
-	const bool userDefinedFoldMarkers = !options.foldExplicitStart.empty() && !options.foldExplicitEnd.empty();
-	for (Sci_PositionU i = startPos; i < endPos; i++) {
-		const char ch = chNext;
-		chNext = styler.SafeGetCharAt(i + 1);
-		const int stylePrev = style;
-		style = styleNext;
-		styleNext = MaskActive(styler.StyleAt(i + 1));
-		const bool atEOL = i == (lineStartNext-1);
-		if ((style == SCE_C_COMMENTLINE) || (style == SCE_C_COMMENTLINEDOC))
-			inLineComment = true;
-		if (options.foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
-			if (!IsStreamCommentStyle(stylePrev)) {
-				levelNext++;
-			} else if (!IsStreamCommentStyle(styleNext) && !atEOL) {
-				// Comments don't end at end of line and the next character may be unstyled.
-				levelNext--;
-			}
-		}
-		if (options.foldComment && options.foldCommentExplicit && ((style == SCE_C_COMMENTLINE) || options.foldExplicitAnywhere)) {
-			if (userDefinedFoldMarkers) {
-				if (styler.Match(i, options.foldExplicitStart.c_str())) {
-					levelNext++;
-				} else if (styler.Match(i, options.foldExplicitEnd.c_str())) {
-					levelNext--;
-				}
-			} else {
-				if ((ch == '/') && (chNext == '/')) {
-					const char chNext2 = styler.SafeGetCharAt(i + 2);
-					if (chNext2 == '{') {
-						levelNext++;
-					} else if (chNext2 == '}') {
-						levelNext--;
-					}
-				}
-			}
-		}
-		if (options.foldPreprocessor && (style == SCE_C_PREPROCESSOR)) {
-			if (ch == '#') {
-				Sci_PositionU j = i + 1;
-				while ((j < endPos) && IsASpaceOrTab(styler.SafeGetCharAt(j))) {
-					j++;
-				}
-				if (styler.Match(j, "region") || styler.Match(j, "if")) {
-					levelNext++;
-				} else if (styler.Match(j, "end")) {
-					levelNext--;
-				}
-
-				if (options.foldPreprocessorAtElse && (styler.Match(j, "else") || styler.Match(j, "elif"))) {
-					levelMinCurrent--;
-				}
-			}
-		}
-		if (options.foldSyntaxBased && (style == SCE_C_OPERATOR)) {
-			if (ch == '{' || ch == '[' || ch == '(') {
-				// Measure the minimum before a '{' to allow
-				// folding on "} else {"
-				if (options.foldAtElse && levelMinCurrent > levelNext) {
-					levelMinCurrent = levelNext;
-				}
-				levelNext++;
-			} else if (ch == '}' || ch == ']' || ch == ')') {
-				levelNext--;
-			}
-		}
-		if (!IsASpace(ch))
-			visibleChars++;
-		if (atEOL || (i == endPos-1)) {
-			int levelUse = levelCurrent;
-			if ((options.foldSyntaxBased && options.foldAtElse) ||
-				(options.foldPreprocessor && options.foldPreprocessorAtElse)
-			) {
-				levelUse = levelMinCurrent;
-			}
-			int lev = levelUse | levelNext << 16;
-			if (visibleChars == 0 && options.foldCompact)
-				lev |= SC_FOLDLEVELWHITEFLAG;
-			if (levelUse < levelNext)
-				lev |= SC_FOLDLEVELHEADERFLAG;
-			if (lev != styler.LevelAt(lineCurrent)) {
-				styler.SetLevel(lineCurrent, lev);
-			}
-			lineCurrent++;
-			lineStartNext = styler.LineStart(lineCurrent+1);
-			levelCurrent = levelNext;
-			levelMinCurrent = levelCurrent;
-			if (atEOL && (i == static_cast<Sci_PositionU>(styler.Length()-1))) {
-				// There is an empty line at end of file so give it same level and empty
-				styler.SetLevel(lineCurrent, (levelCurrent | levelCurrent << 16) | SC_FOLDLEVELWHITEFLAG);
-			}
-			visibleChars = 0;
-			inLineComment = false;
-		}
-	}
+	FolderCPP folder(options, styler, startPos, length, initStyle);
+	// All styles are set so fold to the end
+	folder.FoldTo(styler, styler.Length() + 1);
 }
 
-void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDefinitions) {
+void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolScope &preprocessorDefinitions) {
 
 	// Remove whitespace tokens
 	tokens.erase(std::remove_if(tokens.begin(), tokens.end(), OnlySpaceOrTab), tokens.end());
@@ -1620,8 +1748,7 @@ void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDef
 					tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 3);
 				} else if (((i+3)<tokens.size()) && (tokens[i+3] == ")")) {
 					// defined(<identifier>)
-					const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i+2]);
-					if (it != preprocessorDefinitions.end()) {
+					if (preprocessorDefinitions.Find(tokens[i+2])) {
 						val = "1";
 					}
 					tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 4);
@@ -1631,8 +1758,7 @@ void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDef
 				}
 			} else {
 				// defined <identifier>
-				const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i+1]);
-				if (it != preprocessorDefinitions.end()) {
+				if (preprocessorDefinitions.Find(tokens[i+1])) {
 					val = "1";
 				}
 				tokens.erase(tokens.begin() + i + 1, tokens.begin() + i + 2);
@@ -1649,14 +1775,14 @@ void LexerCPP::EvaluateTokens(Tokens &tokens, const SymbolTable &preprocessorDef
 	for (size_t i = 0; (i<tokens.size()) && (iterations < maxIterations);) {
 		iterations++;
 		if (setWordStart.Contains(tokens[i][0])) {
-			const SymbolTable::const_iterator it = preprocessorDefinitions.find(tokens[i]);
-			if (it != preprocessorDefinitions.end()) {
+			const SymbolValue *symbol = preprocessorDefinitions.Find(tokens[i]);
+			if (symbol) {
 				// Tokenize value
-				Tokens macroTokens = Tokenize(it->second.value);
-				if (it->second.IsMacro()) {
+				Tokens macroTokens = Tokenize(symbol->value);
+				if (symbol->IsMacro()) {
 					if ((i + 1 < tokens.size()) && (tokens.at(i + 1) == "(")) {
 						// Create map of argument name to value
-						const Tokens argumentNames = StringSplit(it->second.arguments, ',');
+						const Tokens argumentNames = StringSplit(symbol->arguments, ',');
 						std::map<std::string, std::string> arguments;
 						size_t arg = 0;
 						size_t tok = i+2;
@@ -1830,15 +1956,18 @@ Tokens LexerCPP::Tokenize(const std::string &expr) const {
 	return tokens;
 }
 
-bool LexerCPP::EvaluateExpression(const std::string &expr, const SymbolTable &preprocessorDefinitions) {
-	Tokens tokens = Tokenize(expr);
-
-	EvaluateTokens(tokens, preprocessorDefinitions);
-
-	// "0" or "" -> false else true
-	const bool isFalse = tokens.empty() ||
-		((tokens.size() == 1) && (tokens[0].empty() || tokens[0] == "0"));
-	return !isFalse;
+bool LexerCPP::EvaluateExpression(const std::string &expr, const SymbolScope &preprocessorDefinitions) {
+	return expressionCache.Evaluate(expr, preprocessorDefinitions,
+		[this](const std::string &text) {
+			return Tokenize(text);
+		},
+		[this, &preprocessorDefinitions](Tokens &tokens) {
+			EvaluateTokens(tokens, preprocessorDefinitions);
+			// "0" or "" -> false else true
+			const bool isFalse = tokens.empty() ||
+				((tokens.size() == 1) && (tokens[0].empty() || tokens[0] == "0"));
+			return !isFalse;
+		});
 }
 
 extern const LexerModule lmCPP(SCLEX_CPP, LexerCPP::LexerFactoryCPP, "cpp", cppWordLists);
@@ -27,6 +27,7 @@
 #include "LexerModule.h"
 #include "OptionSet.h"
 #include "DefaultLexer.h"
+#include "LineStacks.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -213,6 +214,8 @@ class LexerDart : public DefaultLexer {
 	WordList keywordsTypes;
 	OptionsDart options;
 	OptionSetDart osDart;
+	// Interpolation stack at the end of lines inside interpolated strings
+	LineStacks<InterpolatingState> interpolatingAtEol;
 public:
 	LexerDart(const char *languageName_, int language_) :
 		DefaultLexer(languageName_, language_, lexicalClasses, std::size(lexicalClasses)) {
@@ -343,9 +346,15 @@ void LexerDart::Lex(Sci_PositionU startPos, Sci_Position lengthDoc, int initStyl
 	EscapeSequence escSeq;
 
 	if (startPos != 0) {
-		// backtrack to the line where interpolation starts
-		BacktrackToStart(styler, DartLineStateMaskInterpolation, startPos, lengthDoc, initStyle);
+		// continue with the stack saved at the end of the previous line,
+		// otherwise backtrack to the line where interpolation starts
+		const Sci_Position lineStart = styler.GetLine(startPos);
+		if ((startPos != static_cast<Sci_PositionU>(styler.LineStart(lineStart))) ||
+			!interpolatingAtEol.Get(lineStart - 1, interpolatingStack)) {
+			BacktrackToStart(styler, DartLineStateMaskInterpolation, startPos, lengthDoc, initStyle);
+		}
 	}
+	interpolatingAtEol.Truncate(styler.GetLine(startPos));
 
 	StyleContext sc(startPos, lengthDoc, initStyle, styler);
 	if (sc.currentLine > 0) {
@@ -587,6 +596,7 @@ void LexerDart::Lex(Sci_PositionU startPos, Sci_Position lengthDoc, int initStyl
 			int lineState = (commentLevel << 4) | lineStateLineType;
 			if (!interpolatingStack.empty()) {
 				lineState |= DartLineStateMaskInterpolation;
+				interpolatingAtEol.Set(sc.currentLine, interpolatingStack);
 			}
 			styler.SetLineState(sc.currentLine, lineState);
 			lineStateLineType = 0;
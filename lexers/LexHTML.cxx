@@ -17,11 +17,14 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <algorithm>
 #include <functional>
+#include <memory>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 #include "InList.h"
 #include "WordList.h"
 #include "LexAccessor.h"
@@ -30,8 +33,10 @@
 #include "CharacterSet.h"
 #include "LexerModule.h"
 #include "OptionSet.h"
+#include "SparseState.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "SubLexer.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -254,21 +259,31 @@ constexpr bool isCommentASPState(int state) noexcept {
 	return bResult;
 }
 
-bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_PositionU end, const WordList &keywords, const WordClassifier &classifier, Accessor &styler, const std::string &tag) {
+// Tag and attribute names are copied into fixed buffers so classifying them does not allocate.
+// Longer names are truncated which only matters for names that are not in any list.
+constexpr size_t maxNameLength = 100;
+
+bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_PositionU end, const WordList &keywords, const WordClassifier &classifier, Accessor &styler, std::string_view tag) {
 	int chAttr = SCE_H_ATTRIBUTEUNKNOWN;
 	bool isLanguageType = false;
 	if (IsNumberChar(styler[start])) {
 		chAttr = SCE_H_NUMBER;
 	} else {
-		const std::string s = styler.GetRangeLowered(start, end+1);
+		// Room for "tag.attribute" with the attribute copied after the tag
+		char tagAttribute[maxNameLength * 2 + 2] {};
+		const size_t lengthTag = std::min(tag.length(), maxNameLength);
+		tag.copy(tagAttribute, lengthTag);
+		tagAttribute[lengthTag] = '.';
+		char *s = tagAttribute + lengthTag + 1;
+		styler.GetRangeLowered(start, end + 1, s, maxNameLength);
+		const std::string_view attribute(s);
 		if (keywords.InList(s)) {
 			chAttr = SCE_H_ATTRIBUTE;
 		} else {
-			int subStyle = classifier.ValueFor(s);
+			int subStyle = classifier.ValueFor(attribute);
 			if (subStyle < 0) {
 				// Didn't find attribute, check for tag.attribute
-				const std::string tagAttribute = tag + "." + s;
-				subStyle = classifier.ValueFor(tagAttribute);
+				subStyle = classifier.ValueFor(std::string_view(tagAttribute, lengthTag + 1 + attribute.length()));
 			}
 			if (subStyle >= 0) {
 				chAttr = subStyle;
@@ -277,7 +292,7 @@ bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_Posit
 
 		if (inScriptType == eNonHtmlScript) {
 			// see https://html.spec.whatwg.org/multipage/scripting.html#script-processing-model
-			if (s == "type" || s == "language") {
+			if (attribute == "type" || attribute == "language") {
 				isLanguageType = true;
 			}
 		}
@@ -289,14 +304,89 @@ bool classifyAttribHTML(script_mode inScriptType, Sci_PositionU start, Sci_Posit
 	return isLanguageType;
 }
 
+// Elements that change how their tags are lexed or folded.
+// Void elements have no end tag so do not fold. Most are from
+// https://html.spec.whatwg.org/multipage/syntax.html#void-elements with some obsolete elements.
+enum ElementFlags : unsigned int {
+	elementVoid = 1,
+	elementScript = 2,
+	elementComment = 4,
+};
+
+struct Element {
+	std::string_view name;
+	unsigned int flags;
+};
+
+constexpr Element elements[] = {
+	{ "area", elementVoid },
+	{ "base", elementVoid },
+	{ "basefont", elementVoid },
+	{ "br", elementVoid },
+	{ "col", elementVoid },
+	{ "command", elementVoid },
+	{ "comment", elementComment },
+	{ "embed", elementVoid },
+	{ "frame", elementVoid },
+	{ "hr", elementVoid },
+	{ "img", elementVoid },
+	{ "input", elementVoid },
+	{ "isindex", elementVoid },
+	{ "keygen", elementVoid },
+	{ "link", elementVoid },
+	{ "meta", elementVoid },
+	{ "param", elementVoid },
+	{ "script", elementScript },
+	{ "source", elementVoid },
+	{ "track", elementVoid },
+	{ "wbr", elementVoid },
+};
+
+// The multipliers were chosen so that each element has its own slot which is checked below.
+constexpr size_t elementSlots = 64;
+
+constexpr size_t ElementHash(std::string_view name) noexcept {
+	return (name.length() * 5 + static_cast<unsigned char>(name.front()) +
+		static_cast<unsigned char>(name.back()) * 35) % elementSlots;
+}
+
+// Index + 1 of the element in each slot or 0 for an empty slot.
+struct ElementTable {
+	unsigned char slots[elementSlots] {};
+	bool perfect = true;
+	constexpr ElementTable() noexcept {
+		for (size_t i = 0; i < std::size(elements); i++) {
+			unsigned char &slot = slots[ElementHash(elements[i].name)];
+			if (slot) {
+				perfect = false;
+			}
+			slot = static_cast<unsigned char>(i + 1);
+		}
+	}
+};
+
+constexpr ElementTable elementTable;
+static_assert(elementTable.perfect, "Element names must hash to different slots");
+
+unsigned int ElementFlagsFor(std::string_view tag) noexcept {
+	if (tag.empty()) {
+		return 0;
+	}
+	const unsigned char slot = elementTable.slots[ElementHash(tag)];
+	if (slot && (elements[slot - 1].name == tag)) {
+		return elements[slot - 1].flags;
+	}
+	return 0;
+}
+
 // https://html.spec.whatwg.org/multipage/custom-elements.html#custom-elements-core-concepts
-bool isHTMLCustomElement(const std::string &tag) noexcept {
+bool isHTMLCustomElement(std::string_view tag) noexcept {
 	// check valid HTML custom element name: starts with an ASCII lower alpha and contains hyphen.
 	// IsUpperOrLowerCase() is used for `html.tags.case.sensitive=1`.
 	if (tag.length() < 2 || !IsUpperOrLowerCase(tag[0])) {
 		return false;
 	}
-	if (tag.find('-') == std::string::npos) {
+	if (tag.find('-') == std::string_view::npos) {
 		return false;
 	}
 	return true;
@@ -305,28 +395,31 @@ bool isHTMLCustomElement(const std::string &tag) noexcept {
 int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
                     const WordList &keywords, const WordClassifier &classifier, Accessor &styler, bool &tagDontFold,
                     bool caseSensitive, bool isXml, bool allowScripts,
-                    const std::set<std::string> &nonFoldingTags,
-                    std::string &tag) {
-	tag.clear();
+                    std::string &lastTag) {
+	char name[maxNameLength + 1] {};
+	size_t length = 0;
 	// Copy after the '<' and stop before ' '
-	for (Sci_PositionU cPos = start; cPos <= end; cPos++) {
+	for (Sci_PositionU cPos = start; (cPos <= end) && (length < maxNameLength); cPos++) {
 		const char ch = styler[cPos];
 		if (IsASpace(ch)) {
 			break;
 		}
 		if ((ch != '<') && (ch != '/')) {
-			tag.push_back(caseSensitive ? ch : MakeLowerCase(ch));
+			name[length++] = caseSensitive ? ch : MakeLowerCase(ch);
 		}
 	}
+	const std::string_view tag(name, length);
+	// Reuses the capacity of lastTag so does not allocate once it has seen a long tag
+	lastTag.assign(tag);
+	const unsigned int flags = ElementFlagsFor(tag);
 	// if the current language is XML, I can fold any tag
 	// if the current language is HTML, I don't want to fold certain tags (input, meta, etc.)
-	//...to find it in the list of no-container-tags
-	tagDontFold = (!isXml) && (nonFoldingTags.count(tag) > 0);
+	tagDontFold = (!isXml) && (flags & elementVoid);
 	// No keywords -> all are known
 	int chAttr = SCE_H_TAGUNKNOWN;
 	if (!tag.empty() && (tag[0] == '!')) {
 		chAttr = SCE_H_SGML_DEFAULT;
-	} else if (!keywords || keywords.InList(tag)) {
+	} else if (!keywords || keywords.InList(name)) {
 		chAttr = SCE_H_TAG;
 	} else if (!isXml && isHTMLCustomElement(tag)) {
 		chAttr = SCE_H_TAG;
@@ -340,7 +433,7 @@ int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
 		styler.ColourTo(end, chAttr);
 	}
 	if (chAttr == SCE_H_TAG) {
-		if (allowScripts && (tag == "script")) {
+		if (allowScripts && (flags & elementScript)) {
 			// check to see if this is a self-closing tag by sniffing ahead
 			bool isSelfClose = false;
 			for (Sci_PositionU cPos = end; cPos <= end + maxLengthCheck; cPos++) {
@@ -356,7 +449,7 @@ int classifyTagHTML(Sci_PositionU start, Sci_PositionU end,
 			// do not enter a script state if the tag self-closed
 			if (!isSelfClose)
 				chAttr = SCE_H_SCRIPT;
-		} else if (!isXml && (tag == "comment")) {
+		} else if (!isXml && (flags & elementComment)) {
 			chAttr = SCE_H_COMMENT;
 		}
 	}
@@ -568,6 +661,17 @@ public:
 	[[nodiscard]] bool isInvalid() const noexcept { return invalid; }
 	[[nodiscard]] bool isFinished() const noexcept { return finished; }
 
+	[[nodiscard]] bool operator==(const PhpNumberState &other) const noexcept {
+		return (base == other.base) && (decimalPart == other.decimalPart) &&
+			(exponentPart == other.exponentPart) && (invalid == other.invalid) &&
+			(finished == other.finished) && (leadingZero == other.leadingZero) &&
+			(invalidBase8 == other.invalidBase8) && (betweenDigits == other.betweenDigits) &&
+			(decimalChar == other.decimalChar) && (exponentChar == other.exponentChar);
+	}
+	[[nodiscard]] bool operator!=(const PhpNumberState &other) const noexcept {
+		return !(*this == other);
+	}
+
 	bool init(int ch, int chPlus1, int chPlus2) noexcept {
 		base = BASE_10;
 		decimalPart = false;
@@ -765,6 +869,7 @@ struct OptionsHTML {
 	bool foldComment = false;
 	bool foldHeredoc = false;
 	bool foldXmlAtTagOpen = false;
+	std::string scriptLexer;
 };
 
 const char * const htmlWordListDesc[] = {
@@ -845,6 +950,13 @@ struct OptionSetHTML : public OptionSet<OptionsHTML> {
 			"Enable folding for XML at the start of open tag. "
 			"The default is off.");
 
+		DefineProperty("lexer.html.script.lexer", &OptionsHTML::scriptLexer,
+			"Set to the name of a lexer, such as cpp, to style client JavaScript with that lexer "
+			"instead of the JavaScript lexer inside this lexer. Its styles are moved up by 128. "
+			"The JavaScript keywords are its first word list. The application must give a function "
+			"to create lexers with LEXILLA_PRIVATECALL_CREATELEXER. Lexers with more than 64 primary "
+			"styles are not used and secondary styles, like inactive styles, are shown as primary styles.");
+
 		DefineWordListSets(isPHPScript_ ? phpscriptWordListDesc : htmlWordListDesc);
 	}
 };
@@ -852,6 +964,9 @@ struct OptionSetHTML : public OptionSet<OptionsHTML> {
 constexpr char styleSubable[] = { SCE_H_TAG, SCE_H_ATTRIBUTE, SCE_HJ_WORD, SCE_HJA_WORD, SCE_HB_WORD, SCE_HP_WORD, SCE_HPHP_WORD, 0 };
 // Allow normal styles to be contiguous using 0x80 to 0xBF by assigning sub-styles from 0xC0 to 0xFF
 constexpr int SubStylesHTML = 0xC0;
+// Until then, 0x80 to 0xBF are used by the lexer set with lexer.html.script.lexer
+constexpr int StylesScriptLexer = 0x80;
+constexpr int StylesScriptLexerAvailable = 0x40;
 
 const LexicalClass lexicalClassesHTML[] = {
 	// Lexer HTML SCLEX_HTML SCE_H_ SCE_HJ_ SCE_HJA_ SCE_HB_ SCE_HBA_ SCE_HP_ SCE_HPHP_ SCE_HPA_:
@@ -1021,26 +1136,55 @@ const LexicalClass lexicalClassesXML[] = {
 	31, "SCE_H_SGML_BLOCK_DEFAULT", "default", "SGML block",
 };
 
-const char * const tagsThatDoNotFold[] = {
-	"area",
-	"base",
-	"basefont",
-	"br",
-	"col",
-	"command",
-	"embed",
-	"frame",
-	"hr",
-	"img",
-	"input",
-	"isindex",
-	"keygen",
-	"link",
-	"meta",
-	"param",
-	"source",
-	"track",
-	"wbr"
+// Position of the end tag of a script element or end when not found before end.
+Sci_Position ScriptEnd(Accessor &styler, Sci_Position start, Sci_Position end) {
+	for (Sci_Position pos = start; pos < end; pos++) {
+		if ((styler[pos] == '<') && styler.MatchIgnoreCase(pos, "</script")) {
+			return pos;
+		}
+	}
+	return end;
+}
+
+// Lexing state at the start of a line that is inside a tag or PHP string. This does not fit in
+// the line state and allows lexing to resume at the line instead of moving back to the start
+// of the tag or string. The characters before the line are read again from the text so lines
+// inside the same tag or string have equal states. The default state is for other lines.
+struct ResumeState {
+	int state = 0;
+	std::string lastTag;
+	std::string prevWord;
+	PhpNumberState phpNumber;
+	std::string phpStringDelimiter;
+	std::string makoBlockType;
+	int makoComment = 0;
+	std::string djangoBlockType;
+	script_mode inScriptType = eHtml;
+	bool tagOpened = false;
+	bool tagClosing = false;
+	bool tagDontFold = false;
+	script_type aspScript = eScriptNone;
+	script_type clientScript = eScriptNone;
+	int beforePreProc = 0;
+	bool isLanguageType = false;
+	int sgmlBlockLevel = 0;
+	script_type scriptLanguage = eScriptNone;
+	script_type beforeLanguage = eScriptNone;
+
+	[[nodiscard]] bool operator==(const ResumeState &other) const noexcept {
+		return (state == other.state) && (lastTag == other.lastTag) && (prevWord == other.prevWord) &&
+			(phpNumber == other.phpNumber) && (phpStringDelimiter == other.phpStringDelimiter) &&
+			(makoBlockType == other.makoBlockType) && (makoComment == other.makoComment) &&
+			(djangoBlockType == other.djangoBlockType) && (inScriptType == other.inScriptType) &&
+			(tagOpened == other.tagOpened) && (tagClosing == other.tagClosing) &&
+			(tagDontFold == other.tagDontFold) && (aspScript == other.aspScript) &&
+			(clientScript == other.clientScript) && (beforePreProc == other.beforePreProc) &&
+			(isLanguageType == other.isLanguageType) && (sgmlBlockLevel == other.sgmlBlockLevel) &&
+			(scriptLanguage == other.scriptLanguage) && (beforeLanguage == other.beforeLanguage);
+	}
+	[[nodiscard]] bool operator!=(const ResumeState &other) const noexcept {
+		return !(*this == other);
+	}
 };
 
 }
@@ -1056,8 +1200,20 @@ class LexerHTML : public DefaultLexer {
 	WordList keywordsSGML; // SGML (DTD) keywords
 	OptionsHTML options;
 	OptionSetHTML osHTML;
-	std::set<std::string> nonFoldingTags;
 	SubStyles subStyles{styleSubable,SubStylesHTML,SubStylesAvailable,0};
+	// Set for each line where the state changes as most lines are not inside a tag or PHP string
+	// and those that are often continue the same tag or string
+	SparseState<ResumeState> resumeStates;
+	// Set by lexer.html.script.lexer when the application gave createLexer with
+	// LEXILLA_PRIVATECALL_CREATELEXER. Given the JavaScript keywords and those properties of
+	// this lexer that it has.
+	CreateLexerFn createLexer = nullptr;
+	std::unique_ptr<SubLexer> scriptLexer;
+	std::set<std::string> scriptPropertyNames;
+	std::map<std::string, std::string> scriptProperties;
+	std::string scriptKeywords;
+	std::string scriptTags;
+	void CreateScriptLexer();
 public:
 	explicit LexerHTML(bool isXml_, bool isPHPScript_) :
 		DefaultLexer(
@@ -1067,8 +1223,7 @@ public:
 			isXml_ ?  std::size(lexicalClassesXML) : std::size(lexicalClassesHTML)),
 		isXml(isXml_),
 		isPHPScript(isPHPScript_),
-		osHTML(isPHPScript_),
-		nonFoldingTags(std::begin(tagsThatDoNotFold), std::end(tagsThatDoNotFold)) {
+		osHTML(isPHPScript_) {
 	}
 	~LexerHTML() override {
 	}
@@ -1094,6 +1249,7 @@ public:
 	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	// No Fold as all folding performs in Lex.
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) override;
 
 	int SCI_METHOD AllocateSubStyles(int styleBase, int numberStyles) override {
 		return subStyles.Allocate(styleBase, numberStyles);
@@ -1125,6 +1281,10 @@ public:
 	const char *SCI_METHOD GetSubStyleBases() override {
 		return styleSubable;
 	}
+	int SCI_METHOD NamedStyles() override;
+	const char *SCI_METHOD NameOfStyle(int style) override;
+	const char *SCI_METHOD TagsOfStyle(int style) override;
+	const char *SCI_METHOD DescriptionOfStyle(int style) override;
 
 	static ILexer5 *LexerFactoryHTML() {
 		return new LexerHTML(false, false);
@@ -1138,10 +1298,90 @@ public:
 };
 
 Sci_Position SCI_METHOD LexerHTML::PropertySet(const char *key, const char *val) {
+	Sci_Position firstModification = -1;
 	if (osHTML.PropertySet(&options, key, val)) {
-		return 0;
+		firstModification = 0;
+		if (strcmp(key, "lexer.html.script.lexer") == 0) {
+			CreateScriptLexer();
+			return firstModification;
+		}
+	}
+	scriptProperties[key] = val;
+	if (scriptLexer && scriptPropertyNames.count(key) && (scriptLexer->Lexer()->PropertySet(key, val) >= 0)) {
+		firstModification = 0;
 	}
-	return -1;
+	return firstModification;
+}
+
+void *SCI_METHOD LexerHTML::PrivateCall(int operation, void *pointer) {
+	if ((operation == LEXILLA_PRIVATECALL_CREATELEXER) && pointer) {
+		createLexer = *static_cast<CreateLexerFn *>(pointer);
+		CreateScriptLexer();
+		return pointer;
+	}
+	return nullptr;
+}
+
+void LexerHTML::CreateScriptLexer() {
+	scriptLexer.reset();
+	scriptPropertyNames.clear();
+	if (options.scriptLexer.empty() || !createLexer) {
+		return;
+	}
+	ILexer5 *plex = createLexer(options.scriptLexer.c_str());
+	if (!plex) {
+		return;
+	}
+	// Secondary styles, like inactive styles, can be shown as primary styles but primary
+	// styles that do not fit would be lost so then the internal JavaScript lexer is used.
+	const int distanceToSecondaryStyles = plex->DistanceToSecondaryStyles();
+	const int primaryStyles = distanceToSecondaryStyles ? distanceToSecondaryStyles : plex->NamedStyles();
+	if (primaryStyles > StylesScriptLexerAvailable) {
+		plex->Release();
+		return;
+	}
+	scriptLexer = std::make_unique<SubLexer>(plex, StylesScriptLexer, StylesScriptLexerAvailable);
+	// Only forward the properties it has as others, like fold, may mean something else to it
+	std::string_view names = plex->PropertyNames();
+	while (!names.empty()) {
+		const size_t lineEnd = names.find('\n');
+		scriptPropertyNames.emplace(names.substr(0, lineEnd));
+		names.remove_prefix((lineEnd == std::string_view::npos) ? names.length() : lineEnd + 1);
+	}
+	for (const auto &[key, val] : scriptProperties) {
+		if (scriptPropertyNames.count(key)) {
+			plex->PropertySet(key.c_str(), val.c_str());
+		}
+	}
+	plex->WordListSet(0, scriptKeywords.c_str());
+}
+
+int SCI_METHOD LexerHTML::NamedStyles() {
+	// Styles of the script lexer follow those of this lexer
+	return scriptLexer ? (StylesScriptLexer + StylesScriptLexerAvailable) : DefaultLexer::NamedStyles();
+}
+
+const char *SCI_METHOD LexerHTML::NameOfStyle(int style) {
+	if (scriptLexer && scriptLexer->Contains(style)) {
+		return scriptLexer->Lexer()->NameOfStyle(scriptLexer->LexerStyle(style));
+	}
+	return (style < DefaultLexer::NamedStyles()) ? DefaultLexer::NameOfStyle(style) : "";
+}
+
+const char *SCI_METHOD LexerHTML::TagsOfStyle(int style) {
+	if (scriptLexer && scriptLexer->Contains(style)) {
+		scriptTags = "client javascript ";
+		scriptTags += scriptLexer->Lexer()->TagsOfStyle(scriptLexer->LexerStyle(style));
+		return scriptTags.c_str();
+	}
+	return (style < DefaultLexer::NamedStyles()) ? DefaultLexer::TagsOfStyle(style) : "";
+}
+
+const char *SCI_METHOD LexerHTML::DescriptionOfStyle(int style) {
+	if (scriptLexer && scriptLexer->Contains(style)) {
+		return scriptLexer->Lexer()->DescriptionOfStyle(scriptLexer->LexerStyle(style));
+	}
+	return (style < DefaultLexer::NamedStyles()) ? DefaultLexer::DescriptionOfStyle(style) : "";
 }
 
 Sci_Position SCI_METHOD LexerHTML::WordListSet(int n, const char *wl) {
@@ -1177,6 +1417,12 @@ Sci_Position SCI_METHOD LexerHTML::WordListSet(int n, const char *wl) {
 			firstModification = 0;
 		}
 	}
+	if (n == 1) {
+		scriptKeywords = wl;
+		if (scriptLexer && (scriptLexer->Lexer()->WordListSet(0, wl) >= 0)) {
+			firstModification = 0;
+		}
+	}
 	return firstModification;
 }
 
@@ -1194,6 +1440,12 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 	if (isPHPScript && (startPos == 0)) {
 		initStyle = SCE_HPHP_DEFAULT;
 	}
+	// Continue a script styled by scriptLexer
+	bool continueScript = false;
+	if (scriptLexer && (startPos > 0) && scriptLexer->Contains(styler.StyleIndexAt(startPos - 1))) {
+		continueScript = true;
+		initStyle = SCE_HJ_DEFAULT;
+	}
 	std::string lastTag;
 	std::string prevWord;
 	PhpNumberState phpNumber;
@@ -1205,16 +1457,25 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 	std::string djangoBlockType;
 	// If inside a tag, it may be a script tag, so reread from the start of line starting tag to ensure any language tags are seen
 	// PHP string can be heredoc, must find a delimiter first. Reread from beginning of line containing the string, to get the correct lineState
+	// Not needed when the state at the start of the line was saved by an earlier call.
+	bool resuming = false;
+	ResumeState resume;
 	if (StyleNeedsBacktrack(state)) {
-		while ((startPos > 0) && (StyleNeedsBacktrack(styler.StyleIndexAt(startPos - 1)))) {
-			const Sci_Position backLineStart = styler.LineStart(styler.GetLine(startPos-1));
-			length += startPos - backLineStart;
-			startPos = backLineStart;
-		}
-		if (startPos > 0) {
-			state = styler.StyleIndexAt(startPos - 1);
+		const Sci_Position lineStart = styler.GetLine(startPos);
+		resume = resumeStates.ValueAt(lineStart);
+		if ((resume.state == state) && (static_cast<Sci_Position>(startPos) == styler.LineStart(lineStart))) {
+			resuming = true;
 		} else {
-			state = isPHPScript ? SCE_HPHP_DEFAULT : SCE_H_DEFAULT;
+			while ((startPos > 0) && (StyleNeedsBacktrack(styler.StyleIndexAt(startPos - 1)))) {
+				const Sci_Position backLineStart = styler.LineStart(styler.GetLine(startPos-1));
+				length += startPos - backLineStart;
+				startPos = backLineStart;
+			}
+			if (startPos > 0) {
+				state = styler.StyleIndexAt(startPos - 1);
+			} else {
+				state = isPHPScript ? SCE_HPHP_DEFAULT : SCE_H_DEFAULT;
+			}
 		}
 	}
 	styler.StartAt(startPos);
@@ -1302,9 +1563,110 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 
+	if (resuming) {
+		lastTag = std::move(resume.lastTag);
+		prevWord = std::move(resume.prevWord);
+		phpNumber = resume.phpNumber;
+		phpStringDelimiter = std::move(resume.phpStringDelimiter);
+		makoBlockType = std::move(resume.makoBlockType);
+		makoComment = resume.makoComment;
+		djangoBlockType = std::move(resume.djangoBlockType);
+		inScriptType = resume.inScriptType;
+		tagOpened = resume.tagOpened;
+		tagClosing = resume.tagClosing;
+		tagDontFold = resume.tagDontFold;
+		aspScript = resume.aspScript;
+		clientScript = resume.clientScript;
+		beforePreProc = resume.beforePreProc;
+		isLanguageType = resume.isLanguageType;
+		sgmlBlockLevel = resume.sgmlBlockLevel;
+		scriptLanguage = resume.scriptLanguage;
+		beforeLanguage = resume.beforeLanguage;
+		// The line end and the characters before it were the last characters lexed
+		chPrev = SafeGetUnsignedCharAt(styler, startPos - 2);
+		ch = SafeGetUnsignedCharAt(styler, startPos - 1);
+		Sci_Position back = startPos - 1;
+		while ((back > 0) && IsASpace(SafeGetUnsignedCharAt(styler, back))) {
+			back--;
+		}
+		chPrevNonWhite = SafeGetUnsignedCharAt(styler, back);
+	}
+	// Later lines are lexed again
+	resumeStates.Delete(lineCurrent + 1);
+
+	Sci_Position lineResume = -1;
+	auto saveResume = [&](Sci_Position position) {
+		if ((lineResume == lineCurrent) && StyleNeedsBacktrack(state) &&
+			(position == styler.LineStart(lineCurrent))) {
+			resumeStates.Set(lineCurrent, ResumeState {
+				state, lastTag, prevWord, phpNumber, phpStringDelimiter, makoBlockType, makoComment,
+				djangoBlockType, inScriptType, tagOpened, tagClosing, tagDontFold, aspScript,
+				clientScript, beforePreProc, isLanguageType, sgmlBlockLevel, scriptLanguage,
+				beforeLanguage
+			});
+		}
+		lineResume = -1;
+	};
+
+	auto endLine = [&]() {
+		if (fold) {
+			int lev = levelPrev;
+			if (visibleChars == 0)
+				lev |= SC_FOLDLEVELWHITEFLAG;
+			if ((levelCurrent > levelPrev) && (visibleChars > 0))
+				lev |= SC_FOLDLEVELHEADERFLAG;
+
+			styler.SetLevel(lineCurrent, lev);
+			visibleChars = 0;
+			levelPrev = levelCurrent;
+		}
+		styler.SetLineState(lineCurrent,
+		                    ((inScriptType & 0x03) << 0) |
+		                    ((tagOpened ? 1 : 0) << 2) |
+		                    ((tagClosing ? 1 : 0) << 3) |
+		                    ((aspScript & 0x0F) << 4) |
+		                    ((clientScript & 0x0F) << 8) |
+		                    ((beforePreProc & 0xFF) << 12) |
+		                    ((isLanguageType ? 1 : 0) << 20) |
+		                    (sgmlBlockLevel << 21));
+		lineCurrent++;
+		// Cleared here as script lexers may end several lines before saveResume is called
+		resumeStates.Set(lineCurrent, ResumeState());
+		lineResume = lineCurrent;
+		lineStartVisibleChars = 0;
+	};
+
 	styler.StartSegment(startPos);
 	const Sci_Position lengthDoc = startPos + length;
 	for (Sci_Position i = startPos; i < lengthDoc; i++) {
+		if (lineResume >= 0) {
+			saveResume(i);
+		}
+
+		if (scriptLexer && (continueScript ||
+			((state == SCE_HJ_START) && (inScriptType == eNonHtmlScript) && (styler.GetStartSegment() == static_cast<Sci_PositionU>(i))))) {
+			// Style up to the end tag with scriptLexer then continue in this lexer
+			const Sci_Position endScript = ScriptEnd(styler, i, lengthDoc);
+			styler.Flush();
+			scriptLexer->Lex(pAccess, i, endScript - i, continueScript);
+			continueScript = false;
+			for (Sci_Position j = i; j < endScript; j++) {
+				const int chScript = static_cast<unsigned char>(styler[j]);
+				if ((!IsASpace(chScript) || !foldCompact) && fold)
+					visibleChars++;
+				if (!IsASpace(chScript))
+					lineStartVisibleChars++;
+				if ((chScript == '\r' && styler.SafeGetCharAt(j + 1) != '\n') || (chScript == '\n')) {
+					endLine();
+				}
+			}
+			styler.StartAt(endScript);
+			styler.StartSegment(endScript);
+			state = SCE_HJ_DEFAULT;
+			ch = static_cast<unsigned char>(styler.SafeGetCharAt(endScript - 1));
+			i = endScript - 1;
+			continue;
+		}
 		const int chPrev2 = chPrev;
 		chPrev = ch;
 		if (!IsASpace(ch) && state != SCE_HJ_COMMENT &&
@@ -1393,28 +1755,7 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 			// Trigger on CR only (Mac style) or either on LF from CR+LF (Dos/Win) or on LF alone (Unix)
 			// Avoid triggering two times on Dos/Win
 			// New line -> record any line state onto /next/ line
-			if (fold) {
-				int lev = levelPrev;
-				if (visibleChars == 0)
-					lev |= SC_FOLDLEVELWHITEFLAG;
-				if ((levelCurrent > levelPrev) && (visibleChars > 0))
-					lev |= SC_FOLDLEVELHEADERFLAG;
-
-				styler.SetLevel(lineCurrent, lev);
-				visibleChars = 0;
-				levelPrev = levelCurrent;
-			}
-			styler.SetLineState(lineCurrent,
-			                    ((inScriptType & 0x03) << 0) |
-			                    ((tagOpened ? 1 : 0) << 2) |
-			                    ((tagClosing ? 1 : 0) << 3) |
-			                    ((aspScript & 0x0F) << 4) |
-			                    ((clientScript & 0x0F) << 8) |
-			                    ((beforePreProc & 0xFF) << 12) |
-			                    ((isLanguageType ? 1 : 0) << 20) |
-			                    (sgmlBlockLevel << 21));
-			lineCurrent++;
-			lineStartVisibleChars = 0;
+			endLine();
 		}
 
 		// handle start of Mako comment line
@@ -2001,7 +2342,7 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		case SCE_H_TAGUNKNOWN:
 			if (!setTagContinue.Contains(ch) && !((ch == '/') && (chPrev == '<'))) {
 				int eClass = classifyTagHTML(styler.GetStartSegment(),
-					i - 1, keywordsHTML, classifierTags, styler, tagDontFold, caseSensitive, isXml, allowScripts, nonFoldingTags, lastTag);
+					i - 1, keywordsHTML, classifierTags, styler, tagDontFold, caseSensitive, isXml, allowScripts, lastTag);
 				if (eClass == SCE_H_SCRIPT || eClass == SCE_H_COMMENT) {
 					if (!tagClosing) {
 						inScriptType = eNonHtmlScript;
@@ -2756,6 +3097,12 @@ void SCI_METHOD LexerHTML::Lex(Sci_PositionU startPos, Sci_Position length, int
 		break;
 	}
 
+	if (lineResume >= 0) {
+		saveResume(lengthDoc);
+	}
+	// Lines after the range have not been lexed so do not continue the last state
+	resumeStates.Set(lineCurrent + 1, ResumeState());
+
 	// Fill in the real level of the next line, keeping the current flags as they will be filled in later
 	if (fold) {
 		const int flagsNext = styler.LevelAt(lineCurrent) & ~SC_FOLDLEVELNUMBERMASK;
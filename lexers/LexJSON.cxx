@@ -24,6 +24,8 @@
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
+
 #include "WordList.h"
 #include "LexAccessor.h"
 #include "StyleContext.h"
@@ -31,6 +33,7 @@
 #include "LexerModule.h"
 #include "OptionSet.h"
 #include "DefaultLexer.h"
+#include "LexConvergence.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -144,6 +147,7 @@ class LexerJSON : public DefaultLexer {
 	CharacterSet setKeywordJSONLD;
 	CharacterSet setKeywordJSON;
 	CompactIRI compactIRI;
+	LexConvergence convergence;
 
 	static bool IsNextNonWhitespace(LexAccessor &styler, Sci_Position start, char ch) {
 		Sci_Position i = 0;
@@ -256,8 +260,11 @@ class LexerJSON : public DefaultLexer {
 		}
 		return firstModification;
 	}
-	void *SCI_METHOD PrivateCall(int, void *) override {
-		return 0;
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) override {
+		if (operation == LEXILLA_PRIVATECALL_LEXCONVERGE) {
+			return convergence.LexConverge(this, pointer);
+		}
+		return nullptr;
 	}
 	static ILexer5 *LexerFactoryJSON() {
 		return new LexerJSON;
@@ -283,6 +290,14 @@ void SCI_METHOD LexerJSON::Lex(Sci_PositionU startPos,
 	StyleContext context(startPos, length, initStyle, styler);
 	int stringStyleBefore = SCE_JSON_STRING;
 	while (context.More()) {
+		if (context.atLineStart && convergence.Active()) {
+			// Strings and line comments end at line ends so only block comments continue
+			// and they are seen in the style.
+			context.SetState(context.state);
+			if (convergence.AtLineStart(styler, context.currentLine, true)) {
+				break;
+			}
+		}
 		switch (context.state) {
 			case SCE_JSON_BLOCKCOMMENT:
 				if (context.Match("*/")) {
@@ -19,6 +19,7 @@
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 
 #include "WordList.h"
 #include "LexAccessor.h"
@@ -29,6 +30,7 @@
 #include "OptionSet.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "LexConvergence.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -112,6 +114,7 @@ class LexerLua : public DefaultLexer {
 	OptionsLua options;
 	OptionSetLua osLua;
 	SubStyles subStyles{styleSubable};
+	LexConvergence convergence;
 public:
 	explicit LexerLua() :
 		DefaultLexer("lua", SCLEX_LUA, lexicalClasses, std::size(lexicalClasses)) {
@@ -146,6 +149,12 @@ public:
 	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) override {
+		if (operation == LEXILLA_PRIVATECALL_LEXCONVERGE) {
+			return convergence.LexConverge(this, pointer);
+		}
+		return nullptr;
+	}
 
 	int SCI_METHOD AllocateSubStyles(int styleBase, int numberStyles) override {
 		return subStyles.Allocate(styleBase, numberStyles);
@@ -279,15 +288,26 @@ void LexerLua::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, I
 		// shbang line: "#!" is a comment only if located at the start of the script
 		sc.SetState(SCE_LUA_COMMENTLINE);
 	}
+	const auto converged = [&]() {
+		// Long strings and comments are held in the line state
+		sc.SetState(sc.state);
+		return convergence.AtLineStart(styler, sc.currentLine, !foundGoto);
+	};
 	for (; sc.More(); sc.Forward()) {
+		if (sc.atLineStart && convergence.Active() && converged()) {
+			break;
+		}
 		if (sc.atLineEnd) {
 			// Update the line state, so it can be seen by next line
 			currentLine = styler.GetLine(sc.currentPos);
 			switch (sc.state) {
 			case SCE_LUA_DEFAULT:
+			case SCE_LUA_COMMENTDOC:
+				// Separator and string continuation left over from earlier text are not needed
+				styler.SetLineState(currentLine, lastLineDocComment);
+				break;
 			case SCE_LUA_LITERALSTRING:
 			case SCE_LUA_COMMENT:
-			case SCE_LUA_COMMENTDOC:
 			case SCE_LUA_STRING:
 			case SCE_LUA_CHARACTER:
 				// Inside a literal string, block comment or string, we set the line state
@@ -397,6 +417,10 @@ void LexerLua::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, I
 		} else if (AnyOf(sc.state, SCE_LUA_COMMENTLINE, SCE_LUA_COMMENTDOC, SCE_LUA_PREPROCESSOR)) {
 			if (sc.atLineEnd) {
 				sc.ForwardSetState(SCE_LUA_DEFAULT);
+				// Now at the start of the next line which the check above will not see
+				if (sc.More() && convergence.Active() && converged()) {
+					break;
+				}
 			}
 		} else if (sc.state == SCE_LUA_STRING) {
 			if (stringWs) {
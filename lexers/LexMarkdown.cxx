@@ -42,6 +42,8 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
+#include <algorithm>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -63,6 +65,66 @@ constexpr bool IsNewline(const int ch) {
     return (ch == '\n' || ch == '\r' || ch == '\0');
 }
 
+// Line state bit set when the line has more than spaces and tabs
+constexpr int lineStateContent = 1;
+
+// Each line is scanned once when lexing reaches it, before its inline spans are styled.
+// Whether the line has content is kept in line state so following lines can check it
+// without scanning back. The positions where runs of inline delimiters start let a
+// span opener find its closer without rescanning the rest of the line.
+class LineScan {
+    static constexpr std::string_view delimiters = "`*_~";
+    LexAccessor &styler;
+    Sci_Position line;
+    std::vector<Sci_Position> runs[delimiters.length()];
+public:
+    LineScan(LexAccessor &styler_, Sci_Position lineStart) noexcept : styler(styler_), line(lineStart - 1) {
+    }
+    void ScanTo(Sci_Position lineTarget) {
+        while (line < lineTarget) {
+            line++;
+            for (std::vector<Sci_Position> &run : runs) {
+                run.clear();
+            }
+            int lineState = 0;
+            const Sci_Position start = styler.LineStart(line);
+            const Sci_Position end = styler.LineStart(line + 1);
+            char chPrev = (start > 0) ? styler.SafeGetCharAt(start - 1) : '\0';
+            for (Sci_Position pos = start; pos < end; pos++) {
+                const char ch = styler.SafeGetCharAt(pos);
+                if (ch == '\r' || ch == '\n')
+                    break;
+                if (!IsASpaceOrTab(ch))
+                    lineState |= lineStateContent;
+                if (ch == '\0') {
+                    // Ends a search for a closer like a line end does
+                    for (std::vector<Sci_Position> &run : runs) {
+                        run.push_back(pos);
+                    }
+                } else if (ch != chPrev) {
+                    const size_t delimiter = delimiters.find(ch);
+                    if (delimiter != std::string_view::npos)
+                        runs[delimiter].push_back(pos);
+                }
+                chPrev = ch;
+            }
+            styler.SetLineState(line, lineState);
+        }
+    }
+    bool HasContent(Sci_Position lineCheck) {
+        ScanTo(lineCheck);
+        return lineCheck >= 0 && (styler.GetLineState(lineCheck) & lineStateContent);
+    }
+    // Position of the first run of ch starting at or after pos on the last line scanned or -1
+    Sci_Position RunFrom(char ch, Sci_Position pos) {
+        const std::vector<Sci_Position> &run = runs[delimiters.find(ch)];
+        const auto it = std::lower_bound(run.begin(), run.end(), pos);
+        if (it == run.end() || styler.SafeGetCharAt(*it) != ch)
+            return -1;
+        return *it;
+    }
+};
+
 }
 
 // True if can follow ch down to the end with possibly trailing whitespace
@@ -105,42 +167,28 @@ static void SetStateAndZoom(const int state, const Sci_Position length, const in
 }
 
 // Does the previous line have more than spaces and tabs?
-static bool HasPrevLineContent(StyleContext &sc) {
-    Sci_Position i = 0;
-    // Go back to the previous newline
-    while ((--i + (Sci_Position)sc.currentPos) >= 0 && !IsNewline(sc.GetRelative(i)))
-        ;
-    while ((--i + (Sci_Position)sc.currentPos) >= 0) {
-        const int ch = sc.GetRelative(i);
-        if (ch == '\n')
-            break;
-        if (!((ch == '\r' || IsASpaceOrTab(ch))))
-            return true;
-    }
-    return false;
+static bool HasPrevLineContent(StyleContext &sc, LineScan &lines) {
+    return lines.HasContent(sc.currentLine - 1);
 }
 
 static bool AtTermStart(StyleContext &sc) {
     return sc.currentPos == 0 || sc.chPrev == 0 || isspacechar(sc.chPrev);
 }
 
-static bool IsCompleteStyleRegion(StyleContext &sc, const char *token) {
+static bool IsCompleteStyleRegion(StyleContext &sc, LineScan &lines, const char *token) {
     bool found = false;
     const size_t start = strlen(token);
-    Sci_Position i = static_cast<Sci_Position>(start);
-    while (!IsNewline(sc.GetRelative(i))) {
-        // make sure an empty pair of single-char tokens doesn't match
-        // with a longer token: {*}{*} != {**}
-        if (sc.GetRelative(i) == *token && sc.GetRelative(i - 1) != *token) {
-            found = start > 1U ? sc.GetRelative(i + 1) == token[1] : true;
-            break;
-        }
-        i++;
+    lines.ScanTo(sc.currentLine);
+    // Only the start of a run can close so that an empty pair of single-char
+    // tokens doesn't match with a longer token: {*}{*} != {**}
+    const Sci_Position close = lines.RunFrom(*token, sc.currentPos + start);
+    if (close >= 0) {
+        found = start > 1U ? sc.GetRelative(close + 1 - sc.currentPos) == token[1] : true;
     }
     return AtTermStart(sc) && found;
 }
 
-static bool IsValidHrule(const Sci_PositionU endPos, StyleContext &sc) {
+static bool IsValidHrule(const Sci_PositionU endPos, StyleContext &sc, LineScan &lines) {
     int count = 1;
     Sci_Position i = 0;
     for (;;) {
@@ -152,7 +200,7 @@ static bool IsValidHrule(const Sci_PositionU endPos, StyleContext &sc) {
         else if (!IsASpaceOrTab(c) || sc.currentPos + i == endPos) {
             // Are we a valid HRULE
             if ((IsNewline(c) || sc.currentPos + i == endPos) &&
-                    count >= 3 && !HasPrevLineContent(sc)) {
+                    count >= 3 && !HasPrevLineContent(sc, lines)) {
                 sc.SetState(SCE_MARKDOWN_HRULE);
                 sc.Forward(i);
                 sc.SetState(SCE_MARKDOWN_LINE_BEGIN);
@@ -181,8 +229,11 @@ static void ColorizeMarkdownDoc(Sci_PositionU startPos, Sci_Position length, int
     bool headerEOLFill = styler.GetPropertyInt("lexer.markdown.header.eolfill", 0) == 1;
 
     StyleContext sc(startPos, static_cast<Sci_PositionU>(length), initStyle, styler);
+    LineScan lines(styler, sc.currentLine);
 
     while (sc.More()) {
+        lines.ScanTo(sc.currentLine);
+
         // Skip past escaped characters
         if (sc.ch == '\\') {
             sc.Forward();
@@ -313,13 +364,13 @@ static void ColorizeMarkdownDoc(Sci_PositionU startPos, Sci_Position length, int
             }
             // Code block
             else if (sc.Match("~~~")) {
-                if (!HasPrevLineContent(sc))
+                if (!HasPrevLineContent(sc, lines))
                     sc.SetState(SCE_MARKDOWN_CODEBK);
                 else
                     sc.SetState(SCE_MARKDOWN_DEFAULT);
             }
             else if (sc.ch == '=') {
-                if (HasPrevLineContent(sc) && FollowToLineEnd('=', SCE_MARKDOWN_HEADER1, endPos, sc)) {
+                if (HasPrevLineContent(sc, lines) && FollowToLineEnd('=', SCE_MARKDOWN_HEADER1, endPos, sc)) {
                     if (!headerEOLFill)
                         sc.SetState(SCE_MARKDOWN_LINE_BEGIN);
                 }
@@ -327,7 +378,7 @@ static void ColorizeMarkdownDoc(Sci_PositionU startPos, Sci_Position length, int
                     sc.SetState(SCE_MARKDOWN_DEFAULT);
             }
             else if (sc.ch == '-') {
-                if (HasPrevLineContent(sc) && FollowToLineEnd('-', SCE_MARKDOWN_HEADER2, endPos, sc)) {
+                if (HasPrevLineContent(sc, lines) && FollowToLineEnd('-', SCE_MARKDOWN_HEADER2, endPos, sc)) {
                     if (!headerEOLFill)
                         sc.SetState(SCE_MARKDOWN_LINE_BEGIN);
                 }
@@ -365,12 +416,12 @@ static void ColorizeMarkdownDoc(Sci_PositionU startPos, Sci_Position length, int
                 sc.SetState(SCE_MARKDOWN_BLOCKQUOTE);
             /*
             // Begin of code block
-            else if (!HasPrevLineContent(sc) && (sc.chPrev == '\t' || precharCount >= 4))
+            else if (!HasPrevLineContent(sc, lines) && (sc.chPrev == '\t' || precharCount >= 4))
                 sc.SetState(SCE_MARKDOWN_CODEBK);
             */
             // HRule - Total of three or more hyphens, asterisks, or underscores
             // on a line by themselves
-            else if ((sc.ch == '-' || sc.ch == '*' || sc.ch == '_') && IsValidHrule(endPos, sc))
+            else if ((sc.ch == '-' || sc.ch == '*' || sc.ch == '_') && IsValidHrule(endPos, sc, lines))
                 ;
             // Unordered list
             else if ((sc.ch == '-' || sc.ch == '*' || sc.ch == '+') && IsASpaceOrTab(sc.chNext)) {
@@ -445,28 +496,28 @@ static void ColorizeMarkdownDoc(Sci_PositionU startPos, Sci_Position length, int
                 sc.SetState(SCE_MARKDOWN_CODE2);
                 sc.Forward(openingSpan);
             }
-            else if (sc.ch == '`' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, "`")) {
+            else if (sc.ch == '`' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, lines, "`")) {
                 sc.SetState(SCE_MARKDOWN_CODE);
             }
             // Strong
-            else if (sc.Match("**") && sc.GetRelative(2) != ' ' && IsCompleteStyleRegion(sc, "**")) {
+            else if (sc.Match("**") && sc.GetRelative(2) != ' ' && IsCompleteStyleRegion(sc, lines, "**")) {
                 sc.SetState(SCE_MARKDOWN_STRONG1);
                 sc.Forward();
             }
-            else if (sc.Match("__") && sc.GetRelative(2) != ' ' && IsCompleteStyleRegion(sc, "__")) {
+            else if (sc.Match("__") && sc.GetRelative(2) != ' ' && IsCompleteStyleRegion(sc, lines, "__")) {
                 sc.SetState(SCE_MARKDOWN_STRONG2);
                 sc.Forward();
             }
             // Emphasis
-            else if (sc.ch == '*' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, "*")) {
+            else if (sc.ch == '*' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, lines, "*")) {
                 sc.SetState(SCE_MARKDOWN_EM1);
             }
-            else if (sc.ch == '_' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, "_")) {
+            else if (sc.ch == '_' && sc.chNext != ' ' && IsCompleteStyleRegion(sc, lines, "_")) {
                 sc.SetState(SCE_MARKDOWN_EM2);
             }
             // Strikeout
             else if (sc.Match("~~") && !(sc.GetRelative(2) == '~' || sc.GetRelative(2) == ' ') &&
-                     IsCompleteStyleRegion(sc, "~~")) {
+                     IsCompleteStyleRegion(sc, lines, "~~")) {
                 sc.SetState(SCE_MARKDOWN_STRIKEOUT);
                 sc.Forward();
             }
@@ -16,8 +16,11 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
 #include <map>
 #include <functional>
+#include <algorithm>
+#include <iterator>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -30,6 +33,7 @@
 #include "LexerModule.h"
 #include "OptionSet.h"
 #include "DefaultLexer.h"
+#include "LineStacks.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -467,6 +471,41 @@ const LexicalClass lexicalClasses[] = {
 	66, "SCE_PL_STRING_QR_VAR", "identifier interpolated", "qr = regex (interpolated variable)",
 };
 
+class HereDocCls {	// Class to manage HERE doc sequence
+public:
+	int State;
+	// 0: '<<' encountered
+	// 1: collect the delimiter
+	// 2: here doc text (lines after the delimiter)
+	int Quote;		// the char after '<<'
+	bool Quoted;		// true if Quote in ('\'','"','`')
+	bool StripIndent;	// true if '<<~' requested to strip leading whitespace
+	std::string Delimiter;	// the Delimiter
+	HereDocCls() {
+		State = 0;
+		Quote = 0;
+		Quoted = false;
+		StripIndent = false;
+	}
+	void Append(int ch) {
+		Delimiter.push_back(static_cast<char>(ch));
+	}
+	// Style of the here doc text
+	int TextStyle() const noexcept {
+		if (Quoted) {
+			switch (Quote) {
+			case '\'':
+				return SCE_PL_HERE_Q;
+			case '`' :
+				return SCE_PL_HERE_QX;
+			}
+		} else if (Quote == '\\') {
+			return SCE_PL_HERE_Q;
+		}
+		return SCE_PL_HERE_QQ;
+	}
+};
+
 class LexerPerl : public DefaultLexer {
 	CharacterSet setWordStart;
 	CharacterSet setWord;
@@ -475,6 +514,9 @@ class LexerPerl : public DefaultLexer {
 	WordList keywords;
 	OptionsPerl options;
 	OptionSetPerl osPerl;
+	// Here docs not yet terminated at the end of each line with the one whose text is being
+	// lexed first and any stacked after it on the same line following in order.
+	LineStacks<HereDocCls> hereDocsAtEol;
 public:
 	LexerPerl() :
 		DefaultLexer("perl", SCLEX_PERL, lexicalClasses, std::size(lexicalClasses)),
@@ -518,6 +560,7 @@ public:
 	static ILexer5 *LexerFactoryPerl() {
 		return new LexerPerl();
 	}
+	void StoreHereDocs(Sci_Position line, const HereDocCls &hereDoc, const std::vector<HereDocCls> &hereDocsStacked, std::vector<HereDocCls> &hereDocs);
 	int InputSymbolScan(StyleContext &sc);
 	void InterpolateSegment(StyleContext &sc, int maxSeg, bool isPattern=false);
 };
@@ -648,6 +691,15 @@ void LexerPerl::InterpolateSegment(StyleContext &sc, int maxSeg, bool isPattern)
 		sc.SetState(sc.state - INTERPOLATE_SHIFT);
 }
 
+void LexerPerl::StoreHereDocs(Sci_Position line, const HereDocCls &hereDoc, const std::vector<HereDocCls> &hereDocsStacked, std::vector<HereDocCls> &hereDocs) {
+	hereDocs.clear();
+	if (hereDoc.State == 2) {
+		hereDocs.push_back(hereDoc);
+		hereDocs.insert(hereDocs.end(), hereDocsStacked.begin(), hereDocsStacked.end());
+	}
+	hereDocsAtEol.Set(line, hereDocs);
+}
+
 void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 	LexAccessor styler(pAccess);
 
@@ -680,33 +732,10 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	// which characters are being used as quotes, how deeply nested is the
 	// start position and what the termination string is for HERE documents.
 
-	class HereDocCls {	// Class to manage HERE doc sequence
-	public:
-		int State;
-		// 0: '<<' encountered
-		// 1: collect the delimiter
-		// 2: here doc text (lines after the delimiter)
-		int Quote;		// the char after '<<'
-		bool Quoted;		// true if Quote in ('\'','"','`')
-		bool StripIndent;	// true if '<<~' requested to strip leading whitespace
-		int DelimiterLength;	// strlen(Delimiter)
-		char Delimiter[HERE_DELIM_MAX];	// the Delimiter
-		HereDocCls() {
-			State = 0;
-			Quote = 0;
-			Quoted = false;
-			StripIndent = false;
-			DelimiterLength = 0;
-			Delimiter[0] = '\0';
-		}
-		void Append(int ch) {
-			Delimiter[DelimiterLength++] = static_cast<char>(ch);
-			Delimiter[DelimiterLength] = '\0';
-		}
-		~HereDocCls() {
-		}
-	};
-	HereDocCls HereDoc;		// TODO: FIFO for stacked here-docs
+	HereDocCls HereDoc;
+	// Here docs started on the same line as HereDoc whose text follows that of HereDoc
+	std::vector<HereDocCls> hereDocsStacked;
+	std::vector<HereDocCls> hereDocsLine;
 
 	class QuoteCls {	// Class to manage quote pairs
 	public:
@@ -740,17 +769,30 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	// If in a long distance lexical state, backtrack to find quote characters.
 	// Includes strings (may be multi-line), numbers (additional state), format
 	// bodies, as well as POD sections.
-	if (initStyle == SCE_PL_HERE_Q
+	// Here doc text can be resumed at a line start from the here docs stored for the
+	// previous line without needing to find the delimiter.
+	const Sci_Position lineStart = styler.GetLine(startPos);
+	if ((initStyle == SCE_PL_HERE_Q
+	        || initStyle == SCE_PL_HERE_QQ
+	        || initStyle == SCE_PL_HERE_QX)
+	        && (lineStart > 0)
+	        && (static_cast<Sci_Position>(startPos) == styler.LineStart(lineStart))
+	        && hereDocsAtEol.Get(lineStart - 1, hereDocsLine)
+	        && (hereDocsLine.front().TextStyle() == initStyle)) {
+		HereDoc = hereDocsLine.front();
+		hereDocsStacked.assign(hereDocsLine.begin() + 1, hereDocsLine.end());
+	} else if (initStyle == SCE_PL_HERE_Q
 	    || initStyle == SCE_PL_HERE_QQ
 	    || initStyle == SCE_PL_HERE_QX
 	    || initStyle == SCE_PL_FORMAT
 	    || initStyle == SCE_PL_HERE_QQ_VAR
 	    || initStyle == SCE_PL_HERE_QX_VAR
 	   ) {
-		// backtrack through multiple styles to reach the delimiter start
+		// backtrack through multiple styles to reach the delimiter start,
+		// skipping each style run as a whole
 		int delim = (initStyle == SCE_PL_FORMAT) ? SCE_PL_FORMAT_IDENT:SCE_PL_HERE_DELIM;
 		while ((startPos > 1) && (styler.StyleAt(startPos) != delim)) {
-			startPos--;
+			startPos = std::max<Sci_Position>(styler.StyleRunStart(startPos) - 1, 1);
 		}
 		startPos = styler.LineStart(styler.GetLine(startPos));
 		initStyle = styler.StyleAt(startPos - 1);
@@ -777,7 +819,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 			int st = styler.StyleAt(startPos - 1);
 			if ((st != initStyle) && (st != otherStyle))
 				break;
-			startPos--;
+			startPos = std::max<Sci_Position>(styler.StyleRunStart(startPos - 1), 1);
 		}
 		initStyle = SCE_PL_DEFAULT;
 	} else if (initStyle == SCE_PL_STRING_Q
@@ -790,7 +832,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 	        || initStyle == SCE_PL_SUB_PROTOTYPE
 	   ) {
 		while ((startPos > 1) && (styler.StyleAt(startPos - 1) == initStyle)) {
-			startPos--;
+			startPos = std::max<Sci_Position>(styler.StyleRunStart(startPos - 1), 1);
 		}
 		initStyle = SCE_PL_DEFAULT;
 	} else if (initStyle == SCE_PL_POD
@@ -831,6 +873,10 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 	for (; sc.More(); sc.Forward()) {
 
+		if (sc.atLineStart) {
+			StoreHereDocs(sc.currentLine - 1, HereDoc, hereDocsStacked, hereDocsLine);
+		}
+
 		// Determine if the current state should terminate.
 		switch (sc.state) {
 		case SCE_PL_OPERATOR:
@@ -855,6 +901,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 					if ((strcmp(s, "format") == 0)) {
 						sc.SetState(SCE_PL_FORMAT_IDENT);
 						HereDoc.State = 0;
+						hereDocsStacked.clear();
 					} else {
 						sc.SetState(SCE_PL_DEFAULT);
 					}
@@ -968,8 +1015,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				HereDoc.Quote = sc.chNext;
 				HereDoc.Quoted = false;
 				HereDoc.StripIndent = false;
-				HereDoc.DelimiterLength = 0;
-				HereDoc.Delimiter[HereDoc.DelimiterLength] = '\0';
+				HereDoc.Delimiter.clear();
 				if (delim_ch == '~') { // was actually '<<~'
 					sc.Forward();
 					HereDoc.StripIndent = true;
@@ -1030,7 +1076,7 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 						sc.SetState(SCE_PL_DEFAULT);
 					}
 				}
-				if (HereDoc.DelimiterLength >= HERE_DELIM_MAX - 1) {
+				if (HereDoc.Delimiter.length() >= HERE_DELIM_MAX - 1) {
 					sc.SetState(SCE_PL_ERROR);
 					HereDoc.State = 0;
 				}
@@ -1046,13 +1092,22 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 				while (IsASpaceOrTab(sc.ch) && !sc.atLineEnd)
 					sc.Forward();
 			}
-			if (HereDoc.DelimiterLength == 0 || sc.Match(HereDoc.Delimiter)) {
-				int c = sc.GetRelative(HereDoc.DelimiterLength);
+			if (HereDoc.Delimiter.empty() || sc.Match(HereDoc.Delimiter.c_str())) {
+				const Sci_Position delimiterLength = HereDoc.Delimiter.length();
+				int c = sc.GetRelative(delimiterLength);
 				if (c == '\r' || c == '\n') {	// peek first, do not consume match
-					sc.ForwardBytes(HereDoc.DelimiterLength);
-					sc.SetState(SCE_PL_DEFAULT);
-					backFlag = BACK_NONE;
-					HereDoc.State = 0;
+					sc.ForwardBytes(delimiterLength);
+					if (hereDocsStacked.empty()) {
+						sc.SetState(SCE_PL_DEFAULT);
+						backFlag = BACK_NONE;
+						HereDoc.State = 0;
+					} else {
+						// Text of the next stacked here doc starts on the next line
+						HereDoc = hereDocsStacked.front();
+						hereDocsStacked.erase(hereDocsStacked.begin());
+						HereDoc.State = 2;
+						sc.SetState(HereDoc.TextStyle());
+					}
 					if (!sc.atLineEnd)
 						sc.Forward();
 					break;
@@ -1332,34 +1387,24 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 
 		// Must check end of HereDoc states here before default state is handled
-		if (HereDoc.State == 1 && sc.atLineEnd) {
+		if (sc.MatchLineEnd() && (HereDoc.State == 1 || (HereDoc.State != 2 && !hereDocsStacked.empty()))) {
 			// Begin of here-doc (the line after the here-doc delimiter):
 			// Lexically, the here-doc starts from the next line after the >>, but the
 			// first line of here-doc seem to follow the style of the last EOL sequence
-			int st_new = SCE_PL_HERE_QQ;
-			HereDoc.State = 2;
-			if (HereDoc.Quoted) {
-				if (sc.state == SCE_PL_HERE_DELIM) {
+			// which starts at the \r of \r\n
+			if (HereDoc.State == 1) {
+				if (HereDoc.Quoted && (sc.state == SCE_PL_HERE_DELIM)) {
 					// Missing quote at end of string! We are stricter than perl.
 					// Colour here-doc anyway while marking this bit as an error.
 					sc.ChangeState(SCE_PL_ERROR);
 				}
-				switch (HereDoc.Quote) {
-				case '\'':
-					st_new = SCE_PL_HERE_Q;
-					break;
-				case '"' :
-					st_new = SCE_PL_HERE_QQ;
-					break;
-				case '`' :
-					st_new = SCE_PL_HERE_QX;
-					break;
-				}
-			} else {
-				if (HereDoc.Quote == '\\')
-					st_new = SCE_PL_HERE_Q;
+				hereDocsStacked.push_back(HereDoc);
 			}
-			sc.SetState(st_new);
+			// Text follows in the order the here docs were started on this line
+			HereDoc = hereDocsStacked.front();
+			hereDocsStacked.erase(hereDocsStacked.begin());
+			HereDoc.State = 2;
+			sc.SetState(HereDoc.TextStyle());
 		}
 		if (HereDoc.State == 3 && sc.atLineEnd) {
 			// Start of format body.
@@ -1604,6 +1649,10 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 						sc.Forward(3);
 					} else if (preferRE) {
 						sc.SetState(SCE_PL_HERE_DELIM);
+						if (HereDoc.State == 1) {
+							// Another here doc on this line so stack the one already started
+							hereDocsStacked.push_back(HereDoc);
+						}
 						HereDoc.State = 0;
 					} else {		// << operator
 						sc.SetState(SCE_PL_OPERATOR);
@@ -1708,6 +1757,9 @@ void SCI_METHOD LexerPerl::Lex(Sci_PositionU startPos, Sci_Position length, int
 			}
 		}
 	}
+	if (sc.atLineStart) {
+		StoreHereDocs(sc.currentLine - 1, HereDoc, hereDocsStacked, hereDocsLine);
+	}
 	sc.Complete();
 	if (sc.state == SCE_PL_HERE_Q
 	        || sc.state == SCE_PL_HERE_QQ
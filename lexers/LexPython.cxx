@@ -13,12 +13,14 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <optional>
 #include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 
 #include "WordList.h"
 #include "LexAccessor.h"
@@ -30,6 +32,10 @@
 #include "OptionSet.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "LexFoldFusion.h"
+#include "LexConvergence.h"
+#include "StateStream.h"
+#include "LineStacks.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -49,7 +55,7 @@ namespace {
    the f-string and the nesting count for the expression (# of [, (, { seen - # of
    }, ), ] seen).  f-strings may be nested (e.g. f'{ a + f"{1+2}"') so a stack of
    states and nesting counts is kept.  If a f-string expression continues beyond
-   the end of a line, this stack is saved in a std::map that maps a line number to
+   the end of a line, this stack is saved in a LineStacks that maps a line number to
    the stack at the end of that line.  std::vector is used for the stack.
 
    The PEP for f-strings is at https://www.python.org/dev/peps/pep-0498/
@@ -404,7 +410,9 @@ class LexerPython : public DefaultLexer {
 	OptionSetPython osPython;
 	enum { ssIdentifier };
 	SubStyles subStyles{styleSubable};
-	std::map<Sci_Position, std::vector<SingleFStringExpState> > ftripleStateAtEol;
+	LineStacks<SingleFStringExpState> ftripleStateAtEol;
+	LexFoldFusion fusion;
+	LexConvergence convergence;
 public:
 	explicit LexerPython() :
 		DefaultLexer("python", SCLEX_PYTHON, lexicalClasses, std::size(lexicalClasses)) {
@@ -436,8 +444,24 @@ public:
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 
-	void *SCI_METHOD PrivateCall(int, void *) override {
-		return nullptr;
+	void *SaveState(void *pointer) const;
+	void *RestoreState(void *pointer);
+	void *JoinStates(JoinState *join);
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) override {
+		switch (operation) {
+		case LEXILLA_PRIVATECALL_LEXFOLD:
+			return fusion.LexFold(this, pointer);
+		case LEXILLA_PRIVATECALL_SAVESTATE:
+			return SaveState(pointer);
+		case LEXILLA_PRIVATECALL_RESTORESTATE:
+			return RestoreState(pointer);
+		case LEXILLA_PRIVATECALL_LEXCONVERGE:
+			return convergence.LexConverge(this, pointer);
+		case LEXILLA_PRIVATECALL_JOINSTATE:
+			return JoinStates(static_cast<JoinState *>(pointer));
+		default:
+			return nullptr;
+		}
 	}
 
 	int SCI_METHOD LineEndTypesSupported() override {
@@ -534,11 +558,7 @@ void LexerPython::ProcessLineEnd(StyleContext &sc, std::vector<SingleFStringExpS
 	}
 
 	if (!fstringStateStack.empty()) {
-		std::pair<Sci_Position, std::vector<SingleFStringExpState> > val;
-		val.first = sc.currentLine;
-		val.second = fstringStateStack;
-
-		ftripleStateAtEol.insert(val);
+		ftripleStateAtEol.Set(sc.currentLine, fstringStateStack);
 	}
 
 	if ((sc.state == SCE_P_DEFAULT)
@@ -557,9 +577,107 @@ void LexerPython::ProcessLineEnd(StyleContext &sc, std::vector<SingleFStringExpS
 	}
 }
 
+// Increment when the layout of saved state changes
+constexpr int stateVersionPython = 1;
+
+void *LexerPython::SaveState(void *pointer) const {
+	StateWriter writer;
+	writer.Header("python", stateVersionPython);
+	writer.Number(ftripleStateAtEol.Count());
+	for (size_t i = 0; i < ftripleStateAtEol.Count(); i++) {
+		writer.Number(ftripleStateAtEol.Line(i));
+		writer.Number(ftripleStateAtEol.Depth(i));
+		const SingleFStringExpState *stack = ftripleStateAtEol.Bottom(i);
+		for (size_t j = 0; j < ftripleStateAtEol.Depth(i); j++) {
+			writer.Number(stack[j].state);
+			writer.Number(stack[j].nestingCount);
+		}
+	}
+	return writer.CopyTo(pointer);
+}
+
+void *LexerPython::RestoreState(void *pointer) {
+	StateReader reader(pointer);
+	if (!reader.Header("python", stateVersionPython)) {
+		return nullptr;
+	}
+	LineStacks<SingleFStringExpState> ftripleStateAtEolRead;
+	std::vector<SingleFStringExpState> stack;
+	const size_t lines = reader.Count();
+	for (size_t i = 0; i < lines; i++) {
+		const Sci_Position line = reader.Number();
+		const size_t depth = reader.Count();
+		stack.clear();
+		for (size_t j = 0; j < depth; j++) {
+			const int state = static_cast<int>(reader.Number());
+			const int nestingCount = static_cast<int>(reader.Number());
+			stack.push_back({ state, nestingCount });
+		}
+		ftripleStateAtEolRead.Set(line, stack);
+	}
+	if (!reader.Complete()) {
+		return nullptr;
+	}
+	ftripleStateAtEol = std::move(ftripleStateAtEolRead);
+	return pointer;
+}
+
+void *LexerPython::JoinStates(JoinState *join) {
+	const LexerPython *other = dynamic_cast<LexerPython *>(join->other);
+	if (!other) {
+		return nullptr;
+	}
+	// Joined when both have the same f-string stack at the end of the line before
+	std::vector<SingleFStringExpState> stack;
+	std::vector<SingleFStringExpState> stackOther;
+	ftripleStateAtEol.Get(join->line - 1, stack);
+	other->ftripleStateAtEol.Get(join->line - 1 - join->lineOffset, stackOther);
+	join->joined = std::equal(stack.begin(), stack.end(), stackOther.begin(), stackOther.end(),
+		[](const SingleFStringExpState &a, const SingleFStringExpState &b) noexcept {
+		return (a.state == b.state) && (a.nestingCount == b.nestingCount);
+	});
+	if (join->joined) {
+		// Take the other lexer's stacks for the lines it has lexed from line onwards
+		ftripleStateAtEol.Truncate(join->line);
+		for (size_t i = 0; i < other->ftripleStateAtEol.Count(); i++) {
+			const Sci_Position line = other->ftripleStateAtEol.Line(i) + join->lineOffset;
+			if (line >= join->line) {
+				const SingleFStringExpState *bottom = other->ftripleStateAtEol.Bottom(i);
+				stack.assign(bottom, bottom + other->ftripleStateAtEol.Depth(i));
+				ftripleStateAtEol.Set(line, stack);
+			}
+		}
+	}
+	return join;
+}
+
+// Fold state kept between steps so that folding can follow just behind lexing.
+class FolderPython {
+	const OptionsPython &options;
+	const Sci_PositionU startPos;
+	Sci_Position maxLines;
+	Sci_Position docLines;
+	bool started = false;
+	int spaceFlags = 0;
+	Sci_Position lineCurrent = 0;
+	int indentCurrent = 0;
+	int indentCurrentLevel = 0;
+	int prevQuote = false;
+	void Start(Accessor &styler);
+public:
+	FolderPython(const OptionsPython &options_, Accessor &styler, Sci_PositionU startPos_, Sci_Position length);
+	// Fold each line once the styles it needs, those before styled, have been set.
+	void FoldTo(Accessor &styler, Sci_PositionU styled);
+};
+
 void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 	Accessor styler(pAccess, nullptr);
 
+	std::optional<FolderPython> folder;
+	if (fusion.Active() && options.fold) {
+		folder.emplace(options, styler, startPos, length);
+	}
+
 	// Track whether in f-string expression; vector is used for a stack to
 	// handle nested f-strings such as f"""{f'''{f"{f'{1}'}"}'''}"""
 	std::vector<SingleFStringExpState> fstringStateStack;
@@ -567,16 +685,22 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 
 	const Sci_Position endPos = startPos + length;
 
-	// Backtrack to previous line in case need to fix its tab whinging
+	// Whitespace is only examined when tab whinging is on
+	const bool whinge = options.whingeLevel != 0;
+
+	// Backtrack to previous line in case need to fix its tab whinging.
+	// Without whinging, start at the changed line unless it continues a string.
 	Sci_Position lineCurrent = styler.GetLine(startPos);
 	if (startPos > 0) {
 		if (lineCurrent > 0) {
-			lineCurrent--;
-			// Look for backslash-continued lines
+			if (whinge) {
+				lineCurrent--;
+			}
+			// Look for backslash-continued lines as the string may change from its start
 			while (lineCurrent > 0) {
 				const Sci_Position eolPos = styler.LineStart(lineCurrent) - 1;
 				const int eolStyle = styler.StyleIndexAt(eolPos);
-				if (AnyOf(eolStyle, SCE_P_STRING, SCE_P_CHARACTER, SCE_P_STRINGEOL)) {
+				if (IsPySingleQuoteStringState(eolStyle) || (eolStyle == SCE_P_STRINGEOL)) {
 					lineCurrent -= 1;
 				} else {
 					break;
@@ -593,21 +717,20 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 		initStyle = SCE_P_DEFAULT;
 	}
 
+	// Stopping early would lose any f-string stacks of later lines and whinging depends on
+	// the previous line.
+	const bool canConverge = convergence.Active() && !whinge &&
+		((ftripleStateAtEol.Count() == 0) ||
+			(ftripleStateAtEol.Line(ftripleStateAtEol.Count() - 1) < lineCurrent));
+
 	// Set up fstate stack from last line and remove any subsequent ftriple at eol states
-	std::map<Sci_Position, std::vector<SingleFStringExpState> >::iterator it;
-	it = ftripleStateAtEol.find(lineCurrent - 1);
-	if (it != ftripleStateAtEol.end() && !it->second.empty()) {
-		fstringStateStack = it->second;
+	if (ftripleStateAtEol.Get(lineCurrent - 1, fstringStateStack)) {
 		currentFStringExp = &fstringStateStack.back();
 	}
-	it = ftripleStateAtEol.lower_bound(lineCurrent);
-	if (it != ftripleStateAtEol.end()) {
-		ftripleStateAtEol.erase(it, ftripleStateAtEol.end());
-	}
+	ftripleStateAtEol.Truncate(lineCurrent);
 
 	kwType kwLast = kwOther;
 	int spaceFlags = 0;
-	styler.IndentAmount(lineCurrent, &spaceFlags, IsPyComment);
 	bool base_n_number = false;
 
 	const WordClassifier &classifierIdentifiers = subStyles.Classifier(SCE_P_IDENTIFIER);
@@ -620,7 +743,20 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 
 	for (; sc.More(); sc.Forward()) {
 
-		if (sc.atLineStart) {
+		// A continued string may still change style from its start so is not split here.
+		if (canConverge && sc.atLineStart && !IsPySingleQuoteStringState(sc.state)) {
+			sc.SetState(sc.state);
+			const bool sameOther = fstringStateStack.empty() && (kwLast == kwOther);
+			if (convergence.AtLineStart(styler, sc.currentLine, sameOther)) {
+				break;
+			}
+		}
+
+		if (folder && sc.atLineStart) {
+			folder->FoldTo(styler, styler.GetStartSegment());
+		}
+
+		if (sc.atLineStart && whinge) {
 			styler.IndentAmount(lineCurrent, &spaceFlags, IsPyComment);
 			indentGood = true;
 			if (options.whingeLevel == 1) {
@@ -866,7 +1002,6 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 		if (needEOLCheck && sc.atLineEnd) {
 			ProcessLineEnd(sc, fstringStateStack, currentFStringExp, inContinuedString);
 			lineCurrent++;
-			styler.IndentAmount(lineCurrent, &spaceFlags, IsPyComment);
 			if (!sc.More())
 				break;
 		}
@@ -925,6 +1060,9 @@ void SCI_METHOD LexerPython::Lex(Sci_PositionU startPos, Sci_Position length, in
 	}
 	styler.IndicatorFill(startIndicator, sc.currentPos, indicatorWhitespace, 0);
 	sc.Complete();
+	if (folder) {
+		folder->FoldTo(styler, styler.Length() + 1);
+	}
 }
 
 bool IsCommentLine(Sci_Position line, Accessor &styler) {
@@ -941,28 +1079,26 @@ bool IsCommentLine(Sci_Position line, Accessor &styler) {
 }
 
 bool IsQuoteLine(Sci_Position line, const Accessor &styler) {
-	const int style = styler.StyleIndexAt(styler.LineStart(line));
+	const int style = styler.BufferStyleAt(styler.LineStart(line));
 	return IsPyTripleQuoteStringState(style);
 }
 
 
-void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, int /*initStyle - unused*/, IDocument *pAccess) {
-	if (!options.fold)
-		return;
-
-	Accessor styler(pAccess, nullptr);
-
+FolderPython::FolderPython(const OptionsPython &options_, Accessor &styler, Sci_PositionU startPos_, Sci_Position length) :
+	options(options_),
+	startPos(startPos_) {
 	const Sci_Position maxPos = startPos + length;
-	const Sci_Position maxLines = (maxPos == styler.Length()) ? styler.GetLine(maxPos) : styler.GetLine(maxPos - 1);	// Requested last line
-	const Sci_Position docLines = styler.GetLine(styler.Length());	// Available last line
+	maxLines = (maxPos == styler.Length()) ? styler.GetLine(maxPos) : styler.GetLine(maxPos - 1);	// Requested last line
+	docLines = styler.GetLine(styler.Length());	// Available last line
+}
 
+void FolderPython::Start(Accessor &styler) {
 	// Backtrack to previous non-blank line so we can determine indent level
 	// for any white space lines (needed esp. within triple quoted strings)
 	// and so we can fix any preceding fold level (which is why we go back
 	// at least one line in all cases)
-	int spaceFlags = 0;
-	Sci_Position lineCurrent = styler.GetLine(startPos);
-	int indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
+	lineCurrent = styler.GetLine(startPos);
+	indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
 	while (lineCurrent > 0) {
 		lineCurrent--;
 		indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
@@ -971,14 +1107,25 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 				(!IsQuoteLine(lineCurrent, styler)))
 			break;
 	}
-	int indentCurrentLevel = indentCurrent & SC_FOLDLEVELNUMBERMASK;
+	indentCurrentLevel = indentCurrent & SC_FOLDLEVELNUMBERMASK;
 
 	// Set up initial loop state
-	startPos = styler.LineStart(lineCurrent);
+	const Sci_Position lineStartPos = styler.LineStart(lineCurrent);
 	int prev_state = SCE_P_DEFAULT;
 	if (lineCurrent >= 1)
-		prev_state = styler.StyleIndexAt(startPos - 1);
-	int prevQuote = options.foldQuotes && IsPyTripleQuoteStringState(prev_state);
+		prev_state = styler.BufferStyleAt(lineStartPos - 1);
+	prevQuote = options.foldQuotes && IsPyTripleQuoteStringState(prev_state);
+}
+
+void FolderPython::FoldTo(Accessor &styler, Sci_PositionU styled) {
+	if (!started) {
+		// Lexing may have started on an earlier line and the lines before this one are examined
+		if (styled < static_cast<Sci_PositionU>(styler.LineStart(styler.GetLine(startPos)))) {
+			return;
+		}
+		Start(styler);
+		started = true;
+	}
 
 	// Process all characters to end of requested range or end of any triple quote
 	//that hangs over the end of the range.  Cap processing in all cases
@@ -992,9 +1139,13 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 		int quote = false;
 		if (lineNext <= docLines) {
 			// Information about next line is only available if not at end of document
-			indentNext = styler.IndentAmount(lineNext, &spaceFlags, nullptr);
 			const Sci_Position lookAtPos = (styler.LineStart(lineNext) == styler.Length()) ? styler.Length() - 1 : styler.LineStart(lineNext);
-			const int style = styler.StyleIndexAt(lookAtPos);
+			if (static_cast<Sci_PositionU>(lookAtPos) >= styled) {
+				// Wait for the next line to be styled
+				return;
+			}
+			indentNext = styler.IndentAmount(lineNext, &spaceFlags, nullptr);
+			const int style = styler.BufferStyleAt(lookAtPos);
 			quote = options.foldQuotes && IsPyTripleQuoteStringState(style);
 		}
 		const bool quote_start = (quote && !prevQuote);
@@ -1084,6 +1235,16 @@ void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, i
 	//styler.SetLevel(lineCurrent, indentCurrent);
 }
 
+void SCI_METHOD LexerPython::Fold(Sci_PositionU startPos, Sci_Position length, int /*initStyle - unused*/, IDocument *pAccess) {
+	if (!options.fold)
+		return;
+
+	Accessor styler(pAccess, nullptr);
+	FolderPython folder(options, styler, startPos, length);
+	// All styles are set so fold to the end
+	folder.FoldTo(styler, styler.Length() + 1);
+}
+
 }
 
 extern const LexerModule lmPython(SCLEX_PYTHON, LexerPython::LexerFactoryPython, "python",
@@ -46,6 +46,7 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
@@ -165,6 +166,26 @@ struct DelimPair {
 	}
 };
 
+// Lexer state at the start of a line that begins inside a multi-line element (POD, embedded
+// comment, string, Q language, regex or heredoc) so that lexing can restart there.
+// Delimiter scanning resets its nesting counts at each new line so restarting at the line
+// start continues the scan exactly.
+struct RestartPoint {
+	Sci_Position line = 0;
+	int state = SCE_RAKU_DEFAULT;
+	bool inElement = false;		// line start was passed while scanning for the element end
+	DelimPair dpEmbeded;
+	DelimPair dpString;
+	DelimPair dpRegQ;
+	std::string hereDelim;
+	int hereState = 0;
+	int typeDetect = -1;
+	std::string wordLast;
+	std::string identLast;
+	std::string adverbLast;
+	std::string adverbs;		// the adverbs in lastAdverbs that affect lexing
+};
+
 /*----------------------------------------------------------------------------*
  * --- FUNCTIONS ---
  *----------------------------------------------------------------------------*/
@@ -576,10 +597,10 @@ Sci_Position LengthToDelimiter(StyleContext &sc, const DelimPair &dp,
  * LengthToEndHeredoc
  * - returns the length until the end of a heredoc section
  *   - delimiter string MUST begin on a new line
+ *   - on_new_ln is true when restarting at a line start inside the heredoc
  */
 Sci_Position LengthToEndHeredoc(const StyleContext &sc, LexAccessor &styler,
-		const Sci_Position length, const char *delim) {
-	bool on_new_ln = false;
+		const Sci_Position length, const char *delim, bool on_new_ln = false) {
 	int i = 0; // str index
 	for (int n = 0; n < length; n++) {
 		const char ch = styler.SafeGetCharAt(sc.currentPos + n, 0);
@@ -646,6 +667,7 @@ class LexerRaku : public DefaultLexer {
 	WordList typesDomainSpecific;
 	WordList typesExceptions;
 	WordList adverbs;
+	std::vector<RestartPoint> restartPoints;	// sorted by line
 
 public:
 	// Defined as explicit, so that constructor can not be copied
@@ -707,6 +729,9 @@ protected:
 		WordList &wordsAdverbs, DelimPair &dp);
 	Sci_Position LengthToNonWordChar(StyleContext &sc, Sci_Position length,
 		char *s, const int size, Sci_Position offset = 0);
+	const RestartPoint *RestartPointAt(Sci_Position line) const noexcept;
+	void SetRestartPoint(const RestartPoint &rp);
+	void TruncateRestartPoints(Sci_Position line) noexcept;
 };
 
 /*----------------------------------------------------------------------------*
@@ -1024,6 +1049,39 @@ Sci_Position LexerRaku::LengthToNonWordChar(StyleContext &sc, Sci_Position lengt
 	return len;
 }
 
+/*
+ * LexerRaku::RestartPointAt
+ * - returns the restart point of a line or nullptr if it has none
+ */
+const RestartPoint *LexerRaku::RestartPointAt(Sci_Position line) const noexcept {
+	const std::vector<RestartPoint>::const_iterator it = std::lower_bound(
+		restartPoints.begin(), restartPoints.end(), line,
+		[](const RestartPoint &rp, Sci_Position l) noexcept {
+			return rp.line < l;
+		});
+	if (it != restartPoints.end() && it->line == line)
+		return &*it;
+	return nullptr;
+}
+
+/*
+ * LexerRaku::SetRestartPoint
+ * - sets the restart point of a line, removing those of later lines
+ */
+void LexerRaku::SetRestartPoint(const RestartPoint &rp) {
+	TruncateRestartPoints(rp.line);
+	restartPoints.push_back(rp);
+}
+
+/*
+ * LexerRaku::TruncateRestartPoints
+ * - removes the restart points of a line and all later lines
+ */
+void LexerRaku::TruncateRestartPoints(Sci_Position line) noexcept {
+	while (!restartPoints.empty() && restartPoints.back().line >= line)
+		restartPoints.pop_back();
+}
+
 /*
  * LexerRaku::Lex
  * - Main lexer method
@@ -1045,11 +1103,34 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 	char s[100];					// temp char string
 	int typeDetect = -1;			// temp type detected (for regex and Q lang)
 	Sci_Position lengthToEnd;		// length until the end of range
+	bool inElement = false;			// restarting inside an element (heredoc: at a new line)
 
-	// Backtrack to safe start position before complex quoted elements
+	// Restart at the start of a line inside an element when its state was recorded
 
 	Sci_PositionU newStartPos = startPos;
-	if (initStyle != SCE_RAKU_DEFAULT) {
+	const Sci_Position lineStartPos = styler.GetLine(startPos);
+	const RestartPoint *restart = nullptr;
+	if (initStyle != SCE_RAKU_DEFAULT
+			&& static_cast<Sci_Position>(startPos) == styler.LineStart(lineStartPos)) {
+		restart = RestartPointAt(lineStartPos);
+	}
+	if (restart && restart->state == initStyle) {
+		inElement = restart->inElement;
+		dpEmbeded = restart->dpEmbeded;
+		dpString = restart->dpString;
+		dpRegQ = restart->dpRegQ;
+		hereDelim = restart->hereDelim;
+		hereState = restart->hereState;
+		typeDetect = restart->typeDetect;
+		wordLast = restart->wordLast;
+		identLast = restart->identLast;
+		adverbLast = restart->adverbLast;
+		lastAdverbs.Set(restart->adverbs.c_str());
+	}
+
+	// Otherwise backtrack to safe start position before complex quoted elements
+
+	else if (initStyle != SCE_RAKU_DEFAULT) {
 		// Backtrack to last SCE_RAKU_DEFAULT or 0
 		while (newStartPos > 0) {
 			newStartPos--;
@@ -1080,14 +1161,54 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 		length += startPos - newStartPos;
 		startPos = newStartPos;
 	}
+	TruncateRestartPoints(styler.GetLine(startPos) + 1);
 
 	// init StyleContext
 	StyleContext sc(startPos, length, initStyle, styler);
 
+	// Record the state at the start of a line inside an element
+	RestartPoint rp;
+	auto setRestartPoint = [&](Sci_Position line, bool inElementLine) {
+		rp.line = line;
+		rp.state = sc.state;
+		rp.inElement = inElementLine;
+		rp.dpEmbeded = dpEmbeded;
+		rp.dpString = dpString;
+		rp.dpRegQ = dpRegQ;
+		rp.hereDelim = hereDelim;
+		rp.hereState = hereState;
+		rp.typeDetect = typeDetect;
+		rp.wordLast = wordLast;
+		rp.identLast = identLast;
+		rp.adverbLast = adverbLast;
+		rp.adverbs.clear();
+		if (lastAdverbs.InList("to"))
+			rp.adverbs += "to ";
+		if (lastAdverbs.InList("qq"))
+			rp.adverbs += "qq";
+		SetRestartPoint(rp);
+	};
+
+	// Record the lines starting inside an element when scanning 'lenElement' chars for its
+	// end. After an escaped '\n' delimiter scanning continues differently so do not restart.
+	auto setRestartPointsInElement = [&](Sci_Position lenElement) {
+		const Sci_Position end = sc.currentPos + lenElement;
+		const Sci_Position lineEnd = styler.GetLine(end);
+		for (Sci_Position line = sc.currentLine + 1; line <= lineEnd; line++) {
+			const Sci_Position lineStart = styler.LineStart(line);
+			if (styler.SafeGetCharAt(lineStart - 2) != '\\' || styler.SafeGetCharAt(lineStart - 1) != '\n')
+				setRestartPoint(line, true);
+		}
+	};
+
 	// StyleContext Loop
 	for (; sc.More(); sc.Forward()) {
 		lengthToEnd = (length - (sc.currentPos - startPos)); // end of range
 
+		if (sc.atLineStart && sc.state != SCE_RAKU_DEFAULT) {
+			setRestartPoint(sc.currentLine, inElement);
+		}
+
 		/* *** Determine if the current state should terminate ************** *
 		 * Everything within the 'switch' statement processes characters up
 		 * until the end of a syntax highlight section / state.
@@ -1103,9 +1224,11 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 				break;
 			case SCE_RAKU_COMMENTEMBED:
 				if ((len = LengthToDelimiter(sc, dpEmbeded, lengthToEnd)) >= 0) {
+					setRestartPointsInElement(len);
 					sc.Forward(len);			// Move to end delimiter
 					sc.SetState(SCE_RAKU_DEFAULT);
 				} else {
+					setRestartPointsInElement(lengthToEnd);
 					sc.Forward(lengthToEnd);	// no end delimiter found
 				}
 				break;
@@ -1119,14 +1242,20 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 				// Process the string for variables: move to end delimiter
 				if ((len = LengthToDelimiter(sc, dpString, lengthToEnd)) >= 0) {
+					setRestartPointsInElement(len);
 					if (dpString.interpol) {
 						ProcessStringVars(sc, len, SCE_RAKU_STRING_VAR);
 					} else {
 						sc.Forward(len);
 					}
 					sc.SetState(SCE_RAKU_DEFAULT);
-				} else {
-					sc.Forward(lengthToEnd);	// no end delimiter found
+				} else {						// no end delimiter found
+					setRestartPointsInElement(lengthToEnd);
+					if (dpString.interpol) {
+						ProcessStringVars(sc, lengthToEnd, SCE_RAKU_STRING_VAR);
+					} else {
+						sc.Forward(lengthToEnd);
+					}
 				}
 				break;
 			case SCE_RAKU_STRING_Q:
@@ -1141,10 +1270,12 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 				// Process the string for variables: move to end delimiter
 				else if ((len = LengthToDelimiter(sc, dpRegQ, lengthToEnd)) >= 0) {
 
-					// set (any) heredoc delimiter string
+					// set (any) heredoc delimiter string: from the string start
 					if (lastAdverbs.InList("to")) {
 						GetRelativeString(sc, -1, len - dpRegQ.count, hereDelim);
 						hereState = SCE_RAKU_HEREDOC_Q; // default heredoc state
+					} else {
+						setRestartPointsInElement(len);
 					}
 
 					// select variable identifiers
@@ -1155,13 +1286,20 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 						sc.Forward(len);
 					}
 					sc.SetState(SCE_RAKU_DEFAULT);
-				} else {
-					sc.Forward(lengthToEnd);	// no end delimiter found
+				} else {						// no end delimiter found
+					if (!lastAdverbs.InList("to"))
+						setRestartPointsInElement(lengthToEnd);
+					if (sc.state == SCE_RAKU_STRING_QQ || lastAdverbs.InList("qq")) {
+						ProcessStringVars(sc, lengthToEnd, SCE_RAKU_STRING_VAR);
+					} else {
+						sc.Forward(lengthToEnd);
+					}
 				}
 				break;
 			case SCE_RAKU_HEREDOC_Q:
 			case SCE_RAKU_HEREDOC_QQ:
-				if ((len = LengthToEndHeredoc(sc, styler, lengthToEnd, hereDelim.c_str())) >= 0) {
+				if ((len = LengthToEndHeredoc(sc, styler, lengthToEnd, hereDelim.c_str(), inElement)) >= 0) {
+					setRestartPointsInElement(len);
 					// select variable identifiers
 					if (sc.state == SCE_RAKU_HEREDOC_QQ) {
 						ProcessStringVars(sc, len, SCE_RAKU_STRING_VAR);
@@ -1169,8 +1307,13 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 						sc.Forward(len);
 					}
 					sc.SetState(SCE_RAKU_DEFAULT);
-				} else {
-					sc.Forward(lengthToEnd);	// no end delimiter found
+				} else {						// no end delimiter found
+					setRestartPointsInElement(lengthToEnd);
+					if (sc.state == SCE_RAKU_HEREDOC_QQ) {
+						ProcessStringVars(sc, lengthToEnd, SCE_RAKU_STRING_VAR);
+					} else {
+						sc.Forward(lengthToEnd);
+					}
 				}
 				hereDelim.clear();				// clear heredoc delimiter
 				break;
@@ -1188,13 +1331,15 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 
 					// Process the string for variables: move to end delimiter
 					else if ((len = LengthToDelimiter(sc, dpRegQ, lengthToEnd)) >= 0) {
+						setRestartPointsInElement(len);
 						ProcessStringVars(sc, len, SCE_RAKU_REGEX_VAR);
 						if (ProcessRegexTwinCapture(sc, lengthToEnd, typeDetect, dpRegQ))
 							continue;
 						sc.SetState(SCE_RAKU_DEFAULT);
 						break;
-					} else {
-						sc.Forward(lengthToEnd); // no end delimiter found
+					} else {					// no end delimiter found
+						setRestartPointsInElement(lengthToEnd);
+						ProcessStringVars(sc, lengthToEnd, SCE_RAKU_REGEX_VAR);
 						break;
 					}
 				}
@@ -1251,6 +1396,7 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 				sc.SetState(SCE_RAKU_DEFAULT);
 				break;
 		}
+		inElement = false;	// only applies to the element continued at the start
 
 		/* *** Determine if a new state should be entered ******************* *
 		 * Everything below here identifies the beginning of a state, all or part
@@ -1490,6 +1636,11 @@ void SCI_METHOD LexerRaku::Lex(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 
+	// Record the state for lexing that continues at the next line
+	if (sc.atLineStart && sc.state != SCE_RAKU_DEFAULT && !RestartPointAt(sc.currentLine)) {
+		setRestartPoint(sc.currentLine, false);
+	}
+
 	// And we're done...
 	sc.Complete();
 }
@@ -1513,14 +1664,11 @@ void SCI_METHOD LexerRaku::Fold(Sci_PositionU startPos, Sci_Position length, int
 	const Sci_PositionU endPos = startPos + length;
 	Sci_Position lineCurrent = styler.GetLine(startPos);
 
-	// Backtrack to last SCE_RAKU_DEFAULT line
-	if (startPos > 0 && lineCurrent > 0) {
-		while (lineCurrent > 0 && styler.StyleAt(startPos) != SCE_RAKU_DEFAULT) {
-			lineCurrent--;
-			startPos = styler.LineStart(lineCurrent);
-		}
-		lineCurrent = styler.GetLine(startPos);
-	}
+	// The fold level of a line depends on the style at the start of the next line so refold
+	// the previous line which may not have been lexed when it was folded
+	if (lineCurrent > 0)
+		lineCurrent--;
+	startPos = styler.LineStart(lineCurrent);
 	Sci_PositionU lineStart = startPos;
 	Sci_PositionU lineStartNext = styler.LineStart(lineCurrent + 1);
 
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <string_view>
+#include <algorithm>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -247,35 +248,6 @@ void advance_char(Sci_Position &i, char &ch, char &chNext, char &chNext2) noexce
     chNext = chNext2;
 }
 
-// precondition: startPos points to one after the EOL char
-bool currLineContainsHereDelims(Sci_Position &startPos, Accessor &styler) {
-    if (startPos <= 1)
-        return false;
-
-    Sci_Position pos;
-    for (pos = startPos - 1; pos > 0; pos--) {
-        const char ch = styler.SafeGetCharAt(pos);
-        if (isEOLChar(ch)) {
-            // Leave the pointers where they are -- there are no
-            // here doc delims on the current line, even if
-            // the EOL isn't default style
-
-            return false;
-        } else {
-            styler.Flush();
-            if (actual_style(styler.StyleAt(pos)) == SCE_RB_HERE_DELIM) {
-                break;
-            }
-        }
-    }
-    if (pos == 0) {
-        return false;
-    }
-    // Update the pointers so we don't have to re-analyze the string
-    startPos = pos;
-    return true;
-}
-
 // This class is used by the enter and exit methods, so it needs
 // to be hoisted out of the function.
 
@@ -361,13 +333,6 @@ void InterpolateVariable(LexAccessor &styler, int state, Sci_Position &i, char &
     chNext = chNext2;
 }
 
-bool isEmptyLine(Sci_Position pos, Accessor &styler) {
-    int spaceFlags = 0;
-    const Sci_Position lineCurrent = styler.GetLine(pos);
-    const int indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
-    return (indentCurrent & SC_FOLDLEVELWHITEFLAG) != 0;
-}
-
 bool RE_CanFollowKeyword(const char *keyword) noexcept {
     if (!strcmp(keyword, "and")
             || !strcmp(keyword, "begin")
@@ -675,13 +640,13 @@ bool sureThisIsNotHeredoc(Sci_Position lt2StartPos, Accessor &styler) {
     return definitely_not_a_here_doc;
 }
 
-//todo: if we aren't looking at a stdio character,
-// move to the start of the first line that is not in a
-// multi-line construct
+// Move back to the start of the line where the multi-line construct (here doc, string,
+// continued line or #{} expression) that continues into startPos began. ColouriseRbDoc
+// sets the line state of each line to the number of lines back to that line so no
+// characters or styles have to be examined.
 
-void synchronizeDocStart(Sci_PositionU &startPos, Sci_Position &length, int &initStyle, Accessor &styler, bool skipWhiteSpace=false) {
+void synchronizeDocStart(Sci_PositionU &startPos, Sci_Position &length, int &initStyle, Accessor &styler) {
 
-    styler.Flush();
     const int style = actual_style(styler.StyleAt(startPos));
     switch (style) {
     case SCE_RB_STDIN:
@@ -691,35 +656,11 @@ void synchronizeDocStart(Sci_PositionU &startPos, Sci_Position &length, int &ini
         return;
     }
 
-    Sci_Position pos = startPos;
-    // Quick way to characterize each line
-    Sci_Position lineStart;
-    for (lineStart = styler.GetLine(pos); lineStart > 0; lineStart--) {
-        // Now look at the style before the previous line's EOL
-        pos = styler.LineStart(lineStart) - 1;
-        if (pos <= 10) {
-            lineStart = 0;
-            break;
-        }
-        const char ch = styler.SafeGetCharAt(pos);
-        const char chPrev = styler.SafeGetCharAt(pos - 1);
-        if (ch == '\n' && chPrev == '\r') {
-            pos--;
-        }
-        if (styler.SafeGetCharAt(pos - 1) == '\\') {
-            // Continuation line -- keep going
-        } else if (actual_style(styler.StyleAt(pos)) != SCE_RB_DEFAULT) {
-            // Part of multi-line construct -- keep going
-        } else if (currLineContainsHereDelims(pos, styler)) {
-            // Keep going, with pos and length now pointing
-            // at the end of the here-doc delimiter
-        } else if (skipWhiteSpace && isEmptyLine(pos, styler)) {
-            // Keep going
-        } else {
-            break;
-        }
+    Sci_Position lineStart = styler.GetLine(startPos);
+    if (lineStart > 0) {
+        lineStart = std::max<Sci_Position>(lineStart - styler.GetLineState(lineStart - 1), 0);
     }
-    pos = styler.LineStart(lineStart);
+    const Sci_Position pos = styler.LineStart(lineStart);
     length += (startPos - pos);
     startPos = pos;
     initStyle = SCE_RB_DEFAULT;
@@ -751,7 +692,9 @@ void ColouriseRbDoc(Sci_PositionU startPos, Sci_Position length, int initStyle,
 
     QuoteCls Quote;
 
-    synchronizeDocStart(startPos, length, initStyle, styler, false);
+    synchronizeDocStart(startPos, length, initStyle, styler);
+    // First line of the multi-line construct being lexed, if any
+    Sci_Position lineConstructStart = styler.GetLine(startPos);
 
     bool preferRE = true;
     bool afterDef = false;
@@ -1560,6 +1503,18 @@ void ColouriseRbDoc(Sci_PositionU startPos, Sci_Position length, int initStyle,
         if (state == SCE_RB_ERROR) {
             break;
         }
+        if (isEOLChar(ch) && !(ch == '\r' && chNext == '\n')) {
+            // Lexing can start on the next line when nothing continues onto it
+            const Sci_Position lineCurrent = styler.GetLine(i);
+            const bool continued = state != SCE_RB_DEFAULT
+                                   || HereDoc.State != 0
+                                   || innerExpr.canExit()
+                                   || styler.SafeGetCharAt(styler.LineEnd(lineCurrent) - 1) == '\\';
+            if (!continued) {
+                lineConstructStart = lineCurrent + 1;
+            }
+            styler.SetLineState(lineCurrent, static_cast<int>(lineCurrent + 1 - lineConstructStart));
+        }
         chPrev = ch;
     }
     if (state == SCE_RB_WORD) {
@@ -1841,7 +1796,7 @@ void FoldRbDoc(Sci_PositionU startPos, Sci_Position length, int initStyle, WordL
     const bool foldCompact = styler.GetPropertyInt("fold.compact", 1) != 0;
     const bool foldComment = styler.GetPropertyInt("fold.comment") != 0;
 
-    synchronizeDocStart(startPos, length, initStyle, styler, false);
+    synchronizeDocStart(startPos, length, initStyle, styler);
     const Sci_PositionU endPos = startPos + length;
     int visibleChars = 0;
     Sci_Position lineCurrent = styler.GetLine(startPos);
@@ -17,11 +17,13 @@
 #include <string>
 #include <string_view>
 #include <map>
+#include <optional>
 #include <functional>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 
 #include "PropSetSimple.h"
 #include "WordList.h"
@@ -32,6 +34,8 @@
 #include "LexerModule.h"
 #include "OptionSet.h"
 #include "DefaultLexer.h"
+#include "LexFoldFusion.h"
+#include "LexConvergence.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -122,6 +126,8 @@ class LexerRust : public DefaultLexer {
 	WordList keywords[NUM_RUST_KEYWORD_LISTS];
 	OptionsRust options;
 	OptionSetRust osRust;
+	LexFoldFusion fusion;
+	LexConvergence convergence;
 public:
 	LexerRust() : DefaultLexer("rust", SCLEX_RUST) {
 	}
@@ -152,7 +158,13 @@ public:
 	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
-	void * SCI_METHOD PrivateCall(int, void *) override {
+	void * SCI_METHOD PrivateCall(int operation, void *pointer) override {
+		if (operation == LEXILLA_PRIVATECALL_LEXFOLD) {
+			return fusion.LexFold(this, pointer);
+		}
+		if (operation == LEXILLA_PRIVATECALL_LEXCONVERGE) {
+			return convergence.LexConverge(this, pointer);
+		}
 		return 0;
 	}
 	static ILexer5 *LexerFactoryRust() {
@@ -194,9 +206,13 @@ static bool IsIdentifierContinue(int ch) {
 
 static void ScanWhitespace(Accessor& styler, Sci_Position& pos, Sci_Position max) {
 	while (IsWhitespace(styler.SafeGetCharAt(pos, '\0')) && pos < max) {
-		if (pos == styler.LineEnd(styler.GetLine(pos)))
-			styler.SetLineState(styler.GetLine(pos), 0);
+		const Sci_Position line = styler.GetLine(pos);
+		if (pos == styler.LineEnd(line))
+			styler.SetLineState(line, 0);
 		pos++;
+		// Return at each line start so Lex can check whether lexing has converged
+		if (pos == styler.LineStart(line + 1))
+			break;
 	}
 	styler.ColourTo(pos-1, SCE_RUST_DEFAULT);
 }
@@ -687,12 +703,137 @@ static void ScanRawString(Accessor &styler, Sci_Position& pos, Sci_Position max,
 	}
 }
 
+// Fold state kept between steps so that folding can follow just behind lexing.
+class FolderRust {
+	const OptionsRust &options;
+	const Sci_PositionU startPos;
+	const Sci_PositionU endPos;
+	Sci_PositionU position;
+	int visibleChars = 0;
+	bool inLineComment = false;
+	Sci_Position lineCurrent;
+	int levelCurrent = SC_FOLDLEVELBASE;
+	Sci_PositionU lineStartNext;
+	int levelMinCurrent;
+	int levelNext;
+	char chNext = 0;
+	int styleNext = 0;
+	int style;
+	const bool userDefinedFoldMarkers;
+public:
+	FolderRust(const OptionsRust &options_, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle);
+	// Fold each position before styled - 1 as it and the position after it have been styled.
+	void FoldTo(LexAccessor &styler, Sci_PositionU styled);
+};
+
+FolderRust::FolderRust(const OptionsRust &options_, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle) :
+	options(options_),
+	startPos(startPos_),
+	endPos(startPos_ + length),
+	position(startPos_),
+	lineCurrent(styler.GetLine(startPos_)),
+	style(initStyle),
+	userDefinedFoldMarkers(!options_.foldExplicitStart.empty() && !options_.foldExplicitEnd.empty()) {
+	if (lineCurrent > 0)
+		levelCurrent = styler.LevelAt(lineCurrent-1) >> 16;
+	lineStartNext = styler.LineStart(lineCurrent+1);
+	levelMinCurrent = levelCurrent;
+	levelNext = levelCurrent;
+}
+
+void FolderRust::FoldTo(LexAccessor &styler, Sci_PositionU styled) {
+	for (; (position < endPos) && (position + 1 < styled); position++) {
+		const Sci_PositionU i = position;
+		if (i == startPos) {
+			chNext = styler[startPos];
+			styleNext = styler.BufferStyleAt(startPos);
+		}
+		char ch = chNext;
+		chNext = styler.SafeGetCharAt(i + 1);
+		int stylePrev = style;
+		style = styleNext;
+		styleNext = styler.BufferStyleAt(i + 1);
+		bool atEOL = i == (lineStartNext-1);
+		if ((style == SCE_RUST_COMMENTLINE) || (style == SCE_RUST_COMMENTLINEDOC))
+			inLineComment = true;
+		if (options.foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
+			if (!IsStreamCommentStyle(stylePrev)) {
+				levelNext++;
+			} else if (!IsStreamCommentStyle(styleNext) && !atEOL) {
+				// Comments don't end at end of line and the next character may be unstyled.
+				levelNext--;
+			}
+		}
+		if (options.foldComment && options.foldCommentExplicit && ((style == SCE_RUST_COMMENTLINE) || options.foldExplicitAnywhere)) {
+			if (userDefinedFoldMarkers) {
+				if (styler.Match(i, options.foldExplicitStart.c_str())) {
+					levelNext++;
+				} else if (styler.Match(i, options.foldExplicitEnd.c_str())) {
+					levelNext--;
+				}
+			} else {
+				if ((ch == '/') && (chNext == '/')) {
+					char chNext2 = styler.SafeGetCharAt(i + 2);
+					if (chNext2 == '{') {
+						levelNext++;
+					} else if (chNext2 == '}') {
+						levelNext--;
+					}
+				}
+			}
+		}
+		if (options.foldSyntaxBased && (style == SCE_RUST_OPERATOR)) {
+			if (ch == '{') {
+				// Measure the minimum before a '{' to allow
+				// folding on "} else {"
+				if (levelMinCurrent > levelNext) {
+					levelMinCurrent = levelNext;
+				}
+				levelNext++;
+			} else if (ch == '}') {
+				levelNext--;
+			}
+		}
+		if (!IsASpace(ch))
+			visibleChars++;
+		if (atEOL || (i == endPos-1)) {
+			int levelUse = levelCurrent;
+			if (options.foldSyntaxBased && options.foldAtElse) {
+				levelUse = levelMinCurrent;
+			}
+			int lev = levelUse | levelNext << 16;
+			if (visibleChars == 0 && options.foldCompact)
+				lev |= SC_FOLDLEVELWHITEFLAG;
+			if (levelUse < levelNext)
+				lev |= SC_FOLDLEVELHEADERFLAG;
+			if (lev != styler.LevelAt(lineCurrent)) {
+				styler.SetLevel(lineCurrent, lev);
+			}
+			lineCurrent++;
+			lineStartNext = styler.LineStart(lineCurrent+1);
+			levelCurrent = levelNext;
+			levelMinCurrent = levelCurrent;
+			if (atEOL && (i == static_cast<Sci_PositionU>(styler.Length()-1))) {
+				// There is an empty line at end of file so give it same level and empty
+				styler.SetLevel(lineCurrent, (levelCurrent | levelCurrent << 16) | SC_FOLDLEVELWHITEFLAG);
+			}
+			visibleChars = 0;
+			inLineComment = false;
+		}
+	}
+}
+
 void SCI_METHOD LexerRust::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
 	PropSetSimple props;
 	Accessor styler(pAccess, &props);
 	Sci_Position pos = startPos;
 	Sci_Position max = pos + length;
 
+	std::optional<FolderRust> folder;
+	if (fusion.Active() && options.fold) {
+		folder.emplace(options, styler, startPos, length, initStyle);
+	}
+
 	styler.StartAt(pos);
 	styler.StartSegment(pos);
 
@@ -711,6 +852,15 @@ void SCI_METHOD LexerRust::Lex(Sci_PositionU startPos, Sci_Position length, int
 	}
 
 	while (pos < max) {
+		if (folder) {
+			folder->FoldTo(styler, styler.GetStartSegment());
+		}
+		if (convergence.Active()) {
+			const Sci_Position line = styler.GetLine(pos);
+			if ((pos == styler.LineStart(line)) && convergence.AtLineStart(styler, line, true)) {
+				break;
+			}
+		}
 		int c = styler.SafeGetCharAt(pos, '\0');
 		int n = styler.SafeGetCharAt(pos + 1, '\0');
 		int n2 = styler.SafeGetCharAt(pos + 2, '\0');
@@ -761,6 +911,9 @@ void SCI_METHOD LexerRust::Lex(Sci_PositionU startPos, Sci_Position length, int
 	}
 	styler.ColourTo(pos - 1, SCE_RUST_DEFAULT);
 	styler.Flush();
+	if (folder) {
+		folder->FoldTo(styler, styler.Length() + 1);
+	}
 }
 
 void SCI_METHOD LexerRust::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
@@ -769,95 +922,9 @@ void SCI_METHOD LexerRust::Fold(Sci_PositionU startPos, Sci_Position length, int
 		return;
 
 	LexAccessor styler(pAccess);
-
-	Sci_PositionU endPos = startPos + length;
-	int visibleChars = 0;
-	bool inLineComment = false;
-	Sci_Position lineCurrent = styler.GetLine(startPos);
-	int levelCurrent = SC_FOLDLEVELBASE;
-	if (lineCurrent > 0)
-		levelCurrent = styler.LevelAt(lineCurrent-1) >> 16;
-	Sci_PositionU lineStartNext = styler.LineStart(lineCurrent+1);
-	int levelMinCurrent = levelCurrent;
-	int levelNext = levelCurrent;
-	char chNext = styler[startPos];
-	int styleNext = styler.StyleAt(startPos);
-	int style = initStyle;
-	const bool userDefinedFoldMarkers = !options.foldExplicitStart.empty() && !options.foldExplicitEnd.empty();
-	for (Sci_PositionU i = startPos; i < endPos; i++) {
-		char ch = chNext;
-		chNext = styler.SafeGetCharAt(i + 1);
-		int stylePrev = style;
-		style = styleNext;
-		styleNext = styler.StyleAt(i + 1);
-		bool atEOL = i == (lineStartNext-1);
-		if ((style == SCE_RUST_COMMENTLINE) || (style == SCE_RUST_COMMENTLINEDOC))
-			inLineComment = true;
-		if (options.foldComment && options.foldCommentMultiline && IsStreamCommentStyle(style) && !inLineComment) {
-			if (!IsStreamCommentStyle(stylePrev)) {
-				levelNext++;
-			} else if (!IsStreamCommentStyle(styleNext) && !atEOL) {
-				// Comments don't end at end of line and the next character may be unstyled.
-				levelNext--;
-			}
-		}
-		if (options.foldComment && options.foldCommentExplicit && ((style == SCE_RUST_COMMENTLINE) || options.foldExplicitAnywhere)) {
-			if (userDefinedFoldMarkers) {
-				if (styler.Match(i, options.foldExplicitStart.c_str())) {
-					levelNext++;
-				} else if (styler.Match(i, options.foldExplicitEnd.c_str())) {
-					levelNext--;
-				}
-			} else {
-				if ((ch == '/') && (chNext == '/')) {
-					char chNext2 = styler.SafeGetCharAt(i + 2);
-					if (chNext2 == '{') {
-						levelNext++;
-					} else if (chNext2 == '}') {
-						levelNext--;
-					}
-				}
-			}
-		}
-		if (options.foldSyntaxBased && (style == SCE_RUST_OPERATOR)) {
-			if (ch == '{') {
-				// Measure the minimum before a '{' to allow
-				// folding on "} else {"
-				if (levelMinCurrent > levelNext) {
-					levelMinCurrent = levelNext;
-				}
-				levelNext++;
-			} else if (ch == '}') {
-				levelNext--;
-			}
-		}
-		if (!IsASpace(ch))
-			visibleChars++;
-		if (atEOL || (i == endPos-1)) {
-			int levelUse = levelCurrent;
-			if (options.foldSyntaxBased && options.foldAtElse) {
-				levelUse = levelMinCurrent;
-			}
-			int lev = levelUse | levelNext << 16;
-			if (visibleChars == 0 && options.foldCompact)
-				lev |= SC_FOLDLEVELWHITEFLAG;
-			if (levelUse < levelNext)
-				lev |= SC_FOLDLEVELHEADERFLAG;
-			if (lev != styler.LevelAt(lineCurrent)) {
-				styler.SetLevel(lineCurrent, lev);
-			}
-			lineCurrent++;
-			lineStartNext = styler.LineStart(lineCurrent+1);
-			levelCurrent = levelNext;
-			levelMinCurrent = levelCurrent;
-			if (atEOL && (i == static_cast<Sci_PositionU>(styler.Length()-1))) {
-				// There is an empty line at end of file so give it same level and empty
-				styler.SetLevel(lineCurrent, (levelCurrent | levelCurrent << 16) | SC_FOLDLEVELWHITEFLAG);
-			}
-			visibleChars = 0;
-			inLineComment = false;
-		}
-	}
+	FolderRust folder(options, styler, startPos, length, initStyle);
+	// All styles are set so fold to the end
+	folder.FoldTo(styler, styler.Length() + 1);
 }
 
 extern const LexerModule lmRust(SCLEX_RUST, LexerRust::LexerFactoryRust, "rust", rustWordLists);
@@ -16,12 +16,14 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <optional>
 #include <algorithm>
 #include <functional>
 
 #include "ILexer.h"
 #include "Scintilla.h"
 #include "SciLexer.h"
+#include "Lexilla.h"
 
 #include "WordList.h"
 #include "LexAccessor.h"
@@ -32,6 +34,7 @@
 #include "OptionSet.h"
 #include "SparseState.h"
 #include "DefaultLexer.h"
+#include "LexFoldFusion.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -220,6 +223,20 @@ public :
 		return sqlStatement.ValueAt(lineNumber);
 	}
 
+	// Take the states of other, whose line 0 is lineOffset here, after lineNumber when the
+	// state for lineNumber is the same.
+	bool Join(SQLStates &other, Sci_Position lineOffset, Sci_Position lineNumber) {
+		if (ForLine(lineNumber) != other.ForLine(lineNumber - lineOffset))
+			return false;
+		sqlStatement.Delete(lineNumber + 1);
+		for (size_t i = 0; i < other.sqlStatement.size(); i++) {
+			const Sci_Position line = other.sqlStatement.PositionOfIndex(i) + lineOffset;
+			if (line > lineNumber)
+				sqlStatement.Set(line, other.sqlStatement.ValueOfIndex(i));
+		}
+		return true;
+	}
+
 	SQLStates() {}
 
 private :
@@ -351,7 +368,14 @@ public :
 	void SCI_METHOD Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 	void SCI_METHOD Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) override;
 
-	void * SCI_METHOD PrivateCall(int, void *) override {
+	void * SCI_METHOD PrivateCall(int operation, void *pointer) override {
+		if (operation == LEXILLA_PRIVATECALL_LEXFOLD) {
+			return fusion.LexFold(this, pointer);
+		} else if (operation == LEXILLA_PRIVATECALL_SPLITLINE) {
+			return SplitAtStatement(static_cast<SplitLine *>(pointer));
+		} else if (operation == LEXILLA_PRIVATECALL_JOINSTATE) {
+			return JoinStates(static_cast<JoinState *>(pointer));
+		}
 		return 0;
 	}
 
@@ -359,14 +383,14 @@ public :
 		return new LexerSQL();
 	}
 private:
-	bool IsStreamCommentStyle(int style) noexcept {
+	static bool IsStreamCommentStyle(int style) noexcept {
 		return style == SCE_SQL_COMMENT ||
 		       style == SCE_SQL_COMMENTDOC ||
 		       style == SCE_SQL_COMMENTDOCKEYWORD ||
 		       style == SCE_SQL_COMMENTDOCKEYWORDERROR;
 	}
 
-	bool IsCommentStyle (int style) noexcept {
+	static bool IsCommentStyle (int style) noexcept {
 		switch (style) {
 		case SCE_SQL_COMMENT :
 		case SCE_SQL_COMMENTDOC :
@@ -380,11 +404,11 @@ private:
 		}
 	}
 
-	bool IsCommentLine (Sci_Position line, LexAccessor &styler) {
+	static bool IsCommentLine (Sci_Position line, LexAccessor &styler) {
 		const Sci_Position pos = styler.LineStart(line);
 		const Sci_Position eol_pos = styler.LineStart(line + 1) - 1;
 		for (Sci_Position i = pos; i + 1 < eol_pos; i++) {
-			const int style = styler.StyleAt(i);
+			const int style = styler.BufferStyleAt(i);
 			// MySQL needs -- comments to be followed by space or control char
 			if (style == SCE_SQL_COMMENTLINE && styler.Match(i, "--"))
 				return true;
@@ -394,9 +418,38 @@ private:
 		return false;
 	}
 
+	// A statement starts on the line after one ending with ';'. The text has not been lexed
+	// so the ';' may be in a comment or string but then the state after the line will not match
+	// the speculative lex and the chunk is lexed again.
+	void *SplitAtStatement(SplitLine *split) {
+		LexAccessor styler(split->pAccess);
+		for (Sci_Position line = std::max<Sci_Position>(split->line, 1); line < split->lineEnd; line++) {
+			Sci_Position pos = styler.LineStart(line) - 1;
+			const Sci_Position posPreviousLine = styler.LineStart(line - 1);
+			while ((pos > posPreviousLine) && isspacechar(styler[pos]))
+				pos--;
+			if (styler[pos] == ';') {
+				split->line = line;
+				return split;
+			}
+		}
+		return 0;
+	}
+
+	void *JoinStates(JoinState *join) {
+		LexerSQL *other = dynamic_cast<LexerSQL *>(join->other);
+		if (!other)
+			return 0;
+		join->joined = sqlStates.Join(other->sqlStates, join->lineOffset, join->line);
+		return join;
+	}
+
+	class Folder;
+
 	OptionsSQL options;
 	OptionSetSQL osSQL;
 	SQLStates sqlStates;
+	LexFoldFusion fusion;
 
 	WordList keywords1;
 	WordList keywords2;
@@ -444,203 +497,39 @@ Sci_Position SCI_METHOD LexerSQL::WordListSet(int n, const char *wl) {
 	return firstModification;
 }
 
-void SCI_METHOD LexerSQL::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
-	LexAccessor styler(pAccess);
-	StyleContext sc(startPos, length, initStyle, styler);
-	int styleBeforeDCKeyword = SCE_SQL_DEFAULT;
-
-	for (; sc.More(); sc.Forward()) {
-		// Determine if the current state should terminate.
-		switch (sc.state) {
-		case SCE_SQL_OPERATOR:
-			sc.SetState(SCE_SQL_DEFAULT);
-			break;
-		case SCE_SQL_NUMBER:
-			// We stop the number definition on non-numerical non-dot non-eE non-sign char
-			if (!IsANumberChar(sc.ch, sc.chPrev)) {
-				sc.SetState(SCE_SQL_DEFAULT);
-			}
-			break;
-		case SCE_SQL_IDENTIFIER:
-			if (!IsAWordChar(sc.ch, options.sqlAllowDottedWord)) {
-				int nextState = SCE_SQL_DEFAULT;
-				char s[1000];
-				sc.GetCurrentLowered(s, sizeof(s));
-				if (keywords1.InList(s)) {
-					sc.ChangeState(SCE_SQL_WORD);
-				} else if (keywords2.InList(s)) {
-					sc.ChangeState(SCE_SQL_WORD2);
-				} else if (kw_sqlplus.InListAbbreviated(s, '~')) {
-					sc.ChangeState(SCE_SQL_SQLPLUS);
-					if (strncmp(s, "rem", 3) == 0) {
-						nextState = SCE_SQL_SQLPLUS_COMMENT;
-					} else if (strncmp(s, "pro", 3) == 0) {
-						nextState = SCE_SQL_SQLPLUS_PROMPT;
-					}
-				} else if (kw_user1.InList(s)) {
-					sc.ChangeState(SCE_SQL_USER1);
-				} else if (kw_user2.InList(s)) {
-					sc.ChangeState(SCE_SQL_USER2);
-				} else if (kw_user3.InList(s)) {
-					sc.ChangeState(SCE_SQL_USER3);
-				} else if (kw_user4.InList(s)) {
-					sc.ChangeState(SCE_SQL_USER4);
-				}
-				sc.SetState(nextState);
-			}
-			break;
-		case SCE_SQL_QUOTEDIDENTIFIER:
-			if (sc.ch == 0x60) {
-				if (sc.chNext == 0x60) {
-					sc.Forward();	// Ignore it
-				} else {
-					sc.ForwardSetState(SCE_SQL_DEFAULT);
-				}
-			}
-			break;
-		case SCE_SQL_COMMENT:
-			if (sc.Match('*', '/')) {
-				sc.Forward();
-				sc.ForwardSetState(SCE_SQL_DEFAULT);
-			}
-			break;
-		case SCE_SQL_COMMENTDOC:
-			if (sc.Match('*', '/')) {
-				sc.Forward();
-				sc.ForwardSetState(SCE_SQL_DEFAULT);
-			} else if (sc.ch == '@' || sc.ch == '\\') { // Doxygen support
-				// Verify that we have the conditions to mark a comment-doc-keyword
-				if ((IsASpace(sc.chPrev) || sc.chPrev == '*') && (!IsASpace(sc.chNext))) {
-					styleBeforeDCKeyword = SCE_SQL_COMMENTDOC;
-					sc.SetState(SCE_SQL_COMMENTDOCKEYWORD);
-				}
-			}
-			break;
-		case SCE_SQL_COMMENTLINE:
-		case SCE_SQL_COMMENTLINEDOC:
-		case SCE_SQL_SQLPLUS_COMMENT:
-		case SCE_SQL_SQLPLUS_PROMPT:
-			if (sc.atLineStart) {
-				sc.SetState(SCE_SQL_DEFAULT);
-			}
-			break;
-		case SCE_SQL_COMMENTDOCKEYWORD:
-			if ((styleBeforeDCKeyword == SCE_SQL_COMMENTDOC) && sc.Match('*', '/')) {
-				sc.ChangeState(SCE_SQL_COMMENTDOCKEYWORDERROR);
-				sc.Forward();
-				sc.ForwardSetState(SCE_SQL_DEFAULT);
-			} else if (!IsADoxygenChar(sc.ch)) {
-				char s[100];
-				sc.GetCurrentLowered(s, sizeof(s));
-				if (!isspace(sc.ch) || !kw_pldoc.InList(s + 1)) {
-					sc.ChangeState(SCE_SQL_COMMENTDOCKEYWORDERROR);
-				}
-				sc.SetState(styleBeforeDCKeyword);
-			}
-			break;
-		case SCE_SQL_CHARACTER:
-			if (options.sqlBackslashEscapes && sc.ch == '\\') {
-				sc.Forward();
-			} else if (sc.ch == '\'') {
-				if (sc.chNext == '\'') {
-					sc.Forward();
-				} else {
-					sc.ForwardSetState(SCE_SQL_DEFAULT);
-				}
-			}
-			break;
-		case SCE_SQL_STRING:
-			if (options.sqlBackslashEscapes && sc.ch == '\\') {
-				// Escape sequence
-				sc.Forward();
-			} else if (sc.ch == '\"') {
-				if (sc.chNext == '\"') {
-					sc.Forward();
-				} else {
-					sc.ForwardSetState(SCE_SQL_DEFAULT);
-				}
-			}
-			break;
-		case SCE_SQL_QOPERATOR:
-			// Locate the unique Q operator character
-			sc.Complete();
-			char qOperator = 0x00;
-			for (Sci_Position styleStartPos = sc.currentPos; styleStartPos > 0; --styleStartPos) {
-				if (styler.StyleAt(styleStartPos - 1) != SCE_SQL_QOPERATOR) {
-					qOperator = styler.SafeGetCharAt(styleStartPos + 2);
-					break;
-				}
-			}
-
-			char qComplement = 0x00;
-
-			if (qOperator == '<') {
-				qComplement = '>';
-			} else if (qOperator == '(') {
-				qComplement = ')';
-			} else if (qOperator == '{') {
-				qComplement = '}';
-			} else if (qOperator == '[') {
-				qComplement = ']';
-			} else {
-				qComplement = qOperator;
-			}
-
-			if (sc.Match(qComplement, '\'')) {
-				sc.Forward();
-				sc.ForwardSetState(SCE_SQL_DEFAULT);
-			}
-			break;
-		}
-
-		// Determine if a new state should be entered.
-		if (sc.state == SCE_SQL_DEFAULT) {
-			if (sc.Match('q', '\'') || sc.Match('Q', '\'')) {
-				sc.SetState(SCE_SQL_QOPERATOR);
-				sc.Forward();
-			} else if (IsADigit(sc.ch) || (sc.ch == '.' && IsADigit(sc.chNext)) ||
-			          ((sc.ch == '-' || sc.ch == '+') && IsADigit(sc.chNext) && !IsADigit(sc.chPrev))) {
-				sc.SetState(SCE_SQL_NUMBER);
-			} else if (IsAWordStart(sc.ch)) {
-				sc.SetState(SCE_SQL_IDENTIFIER);
-			} else if (sc.ch == 0x60 && options.sqlBackticksIdentifier) {
-				sc.SetState(SCE_SQL_QUOTEDIDENTIFIER);
-			} else if (sc.Match('/', '*')) {
-				if (sc.Match("/**") || sc.Match("/*!")) {	// Support of Doxygen doc. style
-					sc.SetState(SCE_SQL_COMMENTDOC);
-				} else {
-					sc.SetState(SCE_SQL_COMMENT);
-				}
-				sc.Forward();	// Eat the * so it isn't used for the end of the comment
-			} else if (sc.Match('-', '-')) {
-				// MySQL requires a space or control char after --
-				// http://dev.mysql.com/doc/mysql/en/ansi-diff-comments.html
-				// Perhaps we should enforce that with proper property:
-				//~ 			} else if (sc.Match("-- ")) {
-				sc.SetState(SCE_SQL_COMMENTLINE);
-			} else if (sc.ch == '#' && options.sqlNumbersignComment) {
-				sc.SetState(SCE_SQL_COMMENTLINEDOC);
-			} else if (sc.ch == '\'') {
-				sc.SetState(SCE_SQL_CHARACTER);
-			} else if (sc.ch == '\"') {
-				sc.SetState(SCE_SQL_STRING);
-			} else if (isoperator(sc.ch)) {
-				sc.SetState(SCE_SQL_OPERATOR);
-			}
-		}
-	}
-	sc.Complete();
-}
-
-void SCI_METHOD LexerSQL::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
-	if (!options.fold)
-		return;
-	LexAccessor styler(pAccess);
-	Sci_PositionU endPos = startPos + length;
+// Fold state kept between steps so that folding can follow just behind lexing.
+class LexerSQL::Folder {
+	const OptionsSQL &options;
+	SQLStates &sqlStates;
+	Sci_PositionU startPos;
+	Sci_PositionU endPos;
+	Sci_PositionU position;
 	int visibleChars = 0;
-	Sci_Position lineCurrent = styler.GetLine(startPos);
+	Sci_Position lineCurrent;
 	int levelCurrent = SC_FOLDLEVELBASE;
+	int levelNext;
+	char chNext = 0;
+	int styleNext = 0;
+	int style;
+	bool endFound = false;
+	bool isUnfoldingIgnored = false;
+	// this statementFound flag avoids to fold when the statement is on only one line by ignoring ELSE or ELSIF
+	// eg. "IF condition1 THEN ... ELSIF condition2 THEN ... ELSE ... END IF;"
+	bool statementFound = false;
+	sql_state_t sqlStatesCurrentLine = 0;
+public:
+	Folder(LexerSQL &lexer, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle);
+	// Fold each position before styled - 1 as it and the position after it have been styled.
+	void FoldTo(LexAccessor &styler, Sci_PositionU styled);
+};
 
+LexerSQL::Folder::Folder(LexerSQL &lexer, LexAccessor &styler, Sci_PositionU startPos_, Sci_Position length, int initStyle) :
+	options(lexer.options),
+	sqlStates(lexer.sqlStates),
+	startPos(startPos_),
+	endPos(startPos_ + length),
+	lineCurrent(styler.GetLine(startPos_)),
+	style(initStyle) {
 	if (lineCurrent > 0) {
 		// Backtrack to previous line in case need to fix its fold status for folding block of single-line comments (i.e. '--').
 		Sci_Position lastNLPos = -1;
@@ -673,6 +562,7 @@ void SCI_METHOD LexerSQL::Fold(Sci_PositionU startPos, Sci_Position length, int
 		if (lineCurrent > 0)
 			levelCurrent = styler.LevelAt(lineCurrent - 1) >> 16;
 	}
+	position = startPos;
 	// And because folding ends at ';', keep going until we find one
 	// Otherwise if create ... view ... as is split over multiple
 	// lines the folding won't always update immediately.
@@ -683,26 +573,31 @@ void SCI_METHOD LexerSQL::Fold(Sci_PositionU startPos, Sci_Position length, int
 		}
 	}
 
-	int levelNext = levelCurrent;
-	char chNext = styler[startPos];
-	int styleNext = styler.StyleAt(startPos);
-	int style = initStyle;
-	bool endFound = false;
-	bool isUnfoldingIgnored = false;
-	// this statementFound flag avoids to fold when the statement is on only one line by ignoring ELSE or ELSIF
-	// eg. "IF condition1 THEN ... ELSIF condition2 THEN ... ELSE ... END IF;"
-	bool statementFound = false;
-	sql_state_t sqlStatesCurrentLine = 0;
+	levelNext = levelCurrent;
 	if (!options.foldOnlyBegin) {
 		sqlStatesCurrentLine = sqlStates.ForLine(lineCurrent);
 	}
-	for (Sci_PositionU i = startPos; i < endPos; i++) {
+}
+
+void LexerSQL::Folder::FoldTo(LexAccessor &styler, Sci_PositionU styled) {
+	for (; (position < endPos) && (position + 1 < styled); position++) {
+		const Sci_PositionU i = position;
+		if (i == startPos) {
+			chNext = styler[startPos];
+			styleNext = styler.BufferStyleAt(startPos);
+		}
 		const char ch = chNext;
-		chNext = styler.SafeGetCharAt(i + 1);
+		const char chAfter = styler.SafeGetCharAt(i + 1);
+		const bool atEOL = (ch == '\r' && chAfter != '\n') || (ch == '\n');
+		if (atEOL && options.foldComment &&
+			(styler.LineStart(lineCurrent + 2) > static_cast<Sci_Position>(styled))) {
+			// Blocks of line comments are folded using the styles of the next line
+			break;
+		}
+		chNext = chAfter;
 		const int stylePrev = style;
 		style = styleNext;
-		styleNext = styler.StyleAt(i + 1);
-		const bool atEOL = (ch == '\r' && chNext != '\n') || (ch == '\n');
+		styleNext = styler.BufferStyleAt(i + 1);
 		if (atEOL || (!IsCommentStyle(style) && ch == ';')) {
 			if (endFound) {
 				//Maybe this is the end of "EXCEPTION" BLOCK (eg. "BEGIN ... EXCEPTION ... END;")
@@ -969,6 +864,213 @@ void SCI_METHOD LexerSQL::Fold(Sci_PositionU startPos, Sci_Position length, int
 	}
 }
 
+void SCI_METHOD LexerSQL::Lex(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
+	LexAccessor styler(pAccess);
+	std::optional<Folder> folder;
+	if (fusion.Active() && options.fold) {
+		folder.emplace(*this, styler, startPos, length, initStyle);
+	}
+	StyleContext sc(startPos, length, initStyle, styler);
+	int styleBeforeDCKeyword = SCE_SQL_DEFAULT;
+
+	for (; sc.More(); sc.Forward()) {
+		if (folder && sc.atLineStart) {
+			folder->FoldTo(styler, styler.GetStartSegment());
+		}
+		// Determine if the current state should terminate.
+		switch (sc.state) {
+		case SCE_SQL_OPERATOR:
+			sc.SetState(SCE_SQL_DEFAULT);
+			break;
+		case SCE_SQL_NUMBER:
+			// We stop the number definition on non-numerical non-dot non-eE non-sign char
+			if (!IsANumberChar(sc.ch, sc.chPrev)) {
+				sc.SetState(SCE_SQL_DEFAULT);
+			}
+			break;
+		case SCE_SQL_IDENTIFIER:
+			if (!IsAWordChar(sc.ch, options.sqlAllowDottedWord)) {
+				int nextState = SCE_SQL_DEFAULT;
+				char s[1000];
+				sc.GetCurrentLowered(s, sizeof(s));
+				if (keywords1.InList(s)) {
+					sc.ChangeState(SCE_SQL_WORD);
+				} else if (keywords2.InList(s)) {
+					sc.ChangeState(SCE_SQL_WORD2);
+				} else if (kw_sqlplus.InListAbbreviated(s, '~')) {
+					sc.ChangeState(SCE_SQL_SQLPLUS);
+					if (strncmp(s, "rem", 3) == 0) {
+						nextState = SCE_SQL_SQLPLUS_COMMENT;
+					} else if (strncmp(s, "pro", 3) == 0) {
+						nextState = SCE_SQL_SQLPLUS_PROMPT;
+					}
+				} else if (kw_user1.InList(s)) {
+					sc.ChangeState(SCE_SQL_USER1);
+				} else if (kw_user2.InList(s)) {
+					sc.ChangeState(SCE_SQL_USER2);
+				} else if (kw_user3.InList(s)) {
+					sc.ChangeState(SCE_SQL_USER3);
+				} else if (kw_user4.InList(s)) {
+					sc.ChangeState(SCE_SQL_USER4);
+				}
+				sc.SetState(nextState);
+			}
+			break;
+		case SCE_SQL_QUOTEDIDENTIFIER:
+			if (sc.ch == 0x60) {
+				if (sc.chNext == 0x60) {
+					sc.Forward();	// Ignore it
+				} else {
+					sc.ForwardSetState(SCE_SQL_DEFAULT);
+				}
+			}
+			break;
+		case SCE_SQL_COMMENT:
+			if (sc.Match('*', '/')) {
+				sc.Forward();
+				sc.ForwardSetState(SCE_SQL_DEFAULT);
+			}
+			break;
+		case SCE_SQL_COMMENTDOC:
+			if (sc.Match('*', '/')) {
+				sc.Forward();
+				sc.ForwardSetState(SCE_SQL_DEFAULT);
+			} else if (sc.ch == '@' || sc.ch == '\\') { // Doxygen support
+				// Verify that we have the conditions to mark a comment-doc-keyword
+				if ((IsASpace(sc.chPrev) || sc.chPrev == '*') && (!IsASpace(sc.chNext))) {
+					styleBeforeDCKeyword = SCE_SQL_COMMENTDOC;
+					sc.SetState(SCE_SQL_COMMENTDOCKEYWORD);
+				}
+			}
+			break;
+		case SCE_SQL_COMMENTLINE:
+		case SCE_SQL_COMMENTLINEDOC:
+		case SCE_SQL_SQLPLUS_COMMENT:
+		case SCE_SQL_SQLPLUS_PROMPT:
+			if (sc.atLineStart) {
+				sc.SetState(SCE_SQL_DEFAULT);
+			}
+			break;
+		case SCE_SQL_COMMENTDOCKEYWORD:
+			if ((styleBeforeDCKeyword == SCE_SQL_COMMENTDOC) && sc.Match('*', '/')) {
+				sc.ChangeState(SCE_SQL_COMMENTDOCKEYWORDERROR);
+				sc.Forward();
+				sc.ForwardSetState(SCE_SQL_DEFAULT);
+			} else if (!IsADoxygenChar(sc.ch)) {
+				char s[100];
+				sc.GetCurrentLowered(s, sizeof(s));
+				if (!isspace(sc.ch) || !kw_pldoc.InList(s + 1)) {
+					sc.ChangeState(SCE_SQL_COMMENTDOCKEYWORDERROR);
+				}
+				sc.SetState(styleBeforeDCKeyword);
+			}
+			break;
+		case SCE_SQL_CHARACTER:
+			if (options.sqlBackslashEscapes && sc.ch == '\\') {
+				sc.Forward();
+			} else if (sc.ch == '\'') {
+				if (sc.chNext == '\'') {
+					sc.Forward();
+				} else {
+					sc.ForwardSetState(SCE_SQL_DEFAULT);
+				}
+			}
+			break;
+		case SCE_SQL_STRING:
+			if (options.sqlBackslashEscapes && sc.ch == '\\') {
+				// Escape sequence
+				sc.Forward();
+			} else if (sc.ch == '\"') {
+				if (sc.chNext == '\"') {
+					sc.Forward();
+				} else {
+					sc.ForwardSetState(SCE_SQL_DEFAULT);
+				}
+			}
+			break;
+		case SCE_SQL_QOPERATOR:
+			// Locate the unique Q operator character
+			sc.Complete();
+			char qOperator = 0x00;
+			for (Sci_Position styleStartPos = sc.currentPos; styleStartPos > 0; --styleStartPos) {
+				if (styler.StyleAt(styleStartPos - 1) != SCE_SQL_QOPERATOR) {
+					qOperator = styler.SafeGetCharAt(styleStartPos + 2);
+					break;
+				}
+			}
+
+			char qComplement = 0x00;
+
+			if (qOperator == '<') {
+				qComplement = '>';
+			} else if (qOperator == '(') {
+				qComplement = ')';
+			} else if (qOperator == '{') {
+				qComplement = '}';
+			} else if (qOperator == '[') {
+				qComplement = ']';
+			} else {
+				qComplement = qOperator;
+			}
+
+			if (sc.Match(qComplement, '\'')) {
+				sc.Forward();
+				sc.ForwardSetState(SCE_SQL_DEFAULT);
+			}
+			break;
+		}
+
+		// Determine if a new state should be entered.
+		if (sc.state == SCE_SQL_DEFAULT) {
+			if (sc.Match('q', '\'') || sc.Match('Q', '\'')) {
+				sc.SetState(SCE_SQL_QOPERATOR);
+				sc.Forward();
+			} else if (IsADigit(sc.ch) || (sc.ch == '.' && IsADigit(sc.chNext)) ||
+			          ((sc.ch == '-' || sc.ch == '+') && IsADigit(sc.chNext) && !IsADigit(sc.chPrev))) {
+				sc.SetState(SCE_SQL_NUMBER);
+			} else if (IsAWordStart(sc.ch)) {
+				sc.SetState(SCE_SQL_IDENTIFIER);
+			} else if (sc.ch == 0x60 && options.sqlBackticksIdentifier) {
+				sc.SetState(SCE_SQL_QUOTEDIDENTIFIER);
+			} else if (sc.Match('/', '*')) {
+				if (sc.Match("/**") || sc.Match("/*!")) {	// Support of Doxygen doc. style
+					sc.SetState(SCE_SQL_COMMENTDOC);
+				} else {
+					sc.SetState(SCE_SQL_COMMENT);
+				}
+				sc.Forward();	// Eat the * so it isn't used for the end of the comment
+			} else if (sc.Match('-', '-')) {
+				// MySQL requires a space or control char after --
+				// http://dev.mysql.com/doc/mysql/en/ansi-diff-comments.html
+				// Perhaps we should enforce that with proper property:
+				//~ 			} else if (sc.Match("-- ")) {
+				sc.SetState(SCE_SQL_COMMENTLINE);
+			} else if (sc.ch == '#' && options.sqlNumbersignComment) {
+				sc.SetState(SCE_SQL_COMMENTLINEDOC);
+			} else if (sc.ch == '\'') {
+				sc.SetState(SCE_SQL_CHARACTER);
+			} else if (sc.ch == '\"') {
+				sc.SetState(SCE_SQL_STRING);
+			} else if (isoperator(sc.ch)) {
+				sc.SetState(SCE_SQL_OPERATOR);
+			}
+		}
+	}
+	sc.Complete();
+	if (folder) {
+		folder->FoldTo(styler, styler.Length() + 1);
+	}
+}
+
+void SCI_METHOD LexerSQL::Fold(Sci_PositionU startPos, Sci_Position length, int initStyle, IDocument *pAccess) {
+	if (!options.fold)
+		return;
+	LexAccessor styler(pAccess);
+	Folder folder(*this, styler, startPos, length, initStyle);
+	// All styles are set so fold to the end
+	folder.FoldTo(styler, styler.Length() + 1);
+}
+
 }
 
 extern const LexerModule lmSQL(SCLEX_SQL, LexerSQL::LexerFactorySQL, "sql", sqlWordListDesc);
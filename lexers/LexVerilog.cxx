@@ -13,12 +13,18 @@
 #include <assert.h>
 #include <ctype.h>
 
+#include <cstdint>
+
 #include <string>
 #include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <optional>
 #include <algorithm>
+#include <iterator>
 #include <functional>
+#include <memory>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -32,8 +38,10 @@
 #include "LexerModule.h"
 
 #include "OptionSet.h"
+#include "SparseState.h"
 #include "SubStyles.h"
 #include "DefaultLexer.h"
+#include "Preprocessor.h"
 
 using namespace Scintilla;
 using namespace Lexilla;
@@ -41,85 +49,6 @@ using namespace Lexilla;
 namespace {
 	// Use an unnamed namespace to protect the functions and classes from name conflicts
 
-struct PPDefinition {
-	Sci_Position line;
-	std::string key;
-	std::string value;
-	bool isUndef;
-	std::string arguments;
-	PPDefinition(Sci_Position line_, const std::string &key_, const std::string &value_, bool isUndef_ = false, const std::string &arguments_ = "") :
-		line(line_), key(key_), value(value_), isUndef(isUndef_), arguments(arguments_) {
-	}
-};
-
-class LinePPState {
-	int state;
-	int ifTaken;
-	int level;
-	bool ValidLevel() const {
-		return level >= 0 && level < 32;
-	}
-	int maskLevel() const {
-		if (level >= 0) {
-			return 1 << level;
-		} else {
-			return 1;
-		}
-	}
-public:
-	LinePPState() : state(0), ifTaken(0), level(-1) {
-	}
-	bool IsInactive() const {
-		return state != 0;
-	}
-	bool CurrentIfTaken() const {
-		return (ifTaken & maskLevel()) != 0;
-	}
-	void StartSection(bool on) {
-		level++;
-		if (ValidLevel()) {
-			if (on) {
-				state &= ~maskLevel();
-				ifTaken |= maskLevel();
-			} else {
-				state |= maskLevel();
-				ifTaken &= ~maskLevel();
-			}
-		}
-	}
-	void EndSection() {
-		if (ValidLevel()) {
-			state &= ~maskLevel();
-			ifTaken &= ~maskLevel();
-		}
-		level--;
-	}
-	void InvertCurrentLevel() {
-		if (ValidLevel()) {
-			state ^= maskLevel();
-			ifTaken |= maskLevel();
-		}
-	}
-};
-
-// Hold the preprocessor state for each line seen.
-// Currently one entry per line but could become sparse with just one entry per preprocessor line.
-class PPStates {
-	std::vector<LinePPState> vlls;
-public:
-	LinePPState ForLine(Sci_Position line) const {
-		if ((line > 0) && (vlls.size() > static_cast<size_t>(line))) {
-			return vlls[line];
-		} else {
-			return LinePPState();
-		}
-	}
-	void Add(Sci_Position line, LinePPState lls) {
-		vlls.resize(line+1);
-		vlls[line] = lls;
-	}
-};
-
 // Options used for LexerVerilog
 struct OptionsVerilog {
 	bool foldComment;
@@ -186,27 +115,12 @@ class LexerVerilog : public DefaultLexer {
 	WordList keywords4;
 	WordList keywords5;
 	WordList ppDefinitions;
-	PPStates vlls;
-	std::vector<PPDefinition> ppDefineHistory;
-	struct SymbolValue {
-		std::string value;
-		std::string arguments;
-		SymbolValue(const std::string &value_="", const std::string &arguments_="") : value(value_), arguments(arguments_) {
-		}
-		SymbolValue &operator = (const std::string &value_) {
-			value = value_;
-			arguments.clear();
-			return *this;
-		}
-		bool IsMacro() const {
-			return !arguments.empty();
-		}
-	};
-	typedef std::map<std::string, SymbolValue> SymbolTable;
-	SymbolTable preprocessorDefinitionsStart;
+	enum { activeFlag = 0x40 };
+	using PPLineState = LinePPState<activeFlag>;
+	PPStates<PPLineState> vlls;
+	PPDefinitions ppDefineHistory;
 	OptionsVerilog options;
 	OptionSetVerilog osVerilog;
-	enum { activeFlag = 0x40 };
 	SubStyles subStyles;
 
 	// states at end of line (EOL) during fold operations:
@@ -214,8 +128,8 @@ class LexerVerilog : public DefaultLexer {
 	//		foldWaitDisableFlag: EOL while parsing wait or disable statement, terminated by "fork" or '('
 	//		typdefFlag: EOL while parsing typedef statement, terminated by ';'
 	enum {foldExternFlag = 0x01, foldWaitDisableFlag = 0x02, typedefFlag = 0x04, protectedFlag = 0x08};
-	// map using line number as key to store fold state information
-	std::map<Sci_Position, int> foldState;
+	// fold state at the end of each line, stored only where it changes
+	SparseState<int> foldState;
 
 public:
 	LexerVerilog() :
@@ -326,7 +240,7 @@ Sci_Position SCI_METHOD LexerVerilog::WordListSet(int n, const char *wl) {
 			firstModification = 0;
 			if (n == 5) {
 				// Rebuild preprocessorDefinitions
-				preprocessorDefinitionsStart.clear();
+				std::shared_ptr<SymbolChanges> definitionsStart = std::make_shared<SymbolChanges>();
 				for (int nDefinition = 0; nDefinition < ppDefinitions.Length(); nDefinition++) {
 					const char *cpDefinition = ppDefinitions.WordAt(nDefinition);
 					const char *cpEquals = strchr(cpDefinition, '=');
@@ -339,16 +253,16 @@ Sci_Position SCI_METHOD LexerVerilog::WordListSet(int n, const char *wl) {
 							// Macro
 							std::string args = name.substr(bracket + 1, bracketEnd - bracket - 1);
 							name = name.substr(0, bracket);
-							preprocessorDefinitionsStart[name] = SymbolValue(val, args);
+							(*definitionsStart)[name] = SymbolValue(val, args);
 						} else {
-							preprocessorDefinitionsStart[name] = val;
+							(*definitionsStart)[name] = SymbolValue(val, "");
 						}
 					} else {
 						std::string name(cpDefinition);
-						std::string val("1");
-						preprocessorDefinitionsStart[name] = val;
+						(*definitionsStart)[name] = SymbolValue("1", "");
 					}
 				}
+				ppDefineHistory.SetStart(definitionsStart);
 			}
 		}
 	}
@@ -371,15 +285,6 @@ static inline bool AllUpperCase(const char *a) {
 	return true;
 }
 
-// Functor used to truncate history
-struct After {
-	Sci_Position line;
-	explicit After(Sci_Position line_) : line(line_) {}
-	bool operator()(PPDefinition &p) const {
-		return p.line > line;
-	}
-};
-
 static std::string GetRestOfLine(LexAccessor &styler, Sci_Position start, bool allowSpace) {
 	std::string restOfLine;
 	Sci_Position i =0;
@@ -429,28 +334,20 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 	}
 
 	StyleContext sc(startPos, length, initStyle, styler);
-	LinePPState preproc = vlls.ForLine(curLine);
+	PPLineState preproc = vlls.ForLine(curLine);
 
 	bool definitionsChanged = false;
 
 	// Truncate ppDefineHistory before current line
 
 	if (!options.updatePreprocessor)
-		ppDefineHistory.clear();
+		ppDefineHistory.Clear();
 
-	std::vector<PPDefinition>::iterator itInvalid = std::find_if(ppDefineHistory.begin(), ppDefineHistory.end(), After(curLine-1));
-	if (itInvalid != ppDefineHistory.end()) {
-		ppDefineHistory.erase(itInvalid, ppDefineHistory.end());
+	if (ppDefineHistory.Truncate(curLine)) {
 		definitionsChanged = true;
 	}
 
-	SymbolTable preprocessorDefinitions = preprocessorDefinitionsStart;
-	for (std::vector<PPDefinition>::iterator itDef = ppDefineHistory.begin(); itDef != ppDefineHistory.end(); ++itDef) {
-		if (itDef->isUndef)
-			preprocessorDefinitions.erase(itDef->key);
-		else
-			preprocessorDefinitions[itDef->key] = SymbolValue(itDef->value, itDef->arguments);
-	}
+	SymbolScope preprocessorDefinitions = ppDefineHistory.Scope();
 
 	int activitySet = preproc.IsInactive() ? activeFlag : 0;
 	Sci_Position lineEndNext = styler.LineEnd(curLine);
@@ -637,7 +534,7 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 							bool isIfDef = sc.Match("ifdef");
 							int i = isIfDef ? 5 : 6;
 							std::string restOfLine = GetRestOfLine(styler, sc.currentPos + i + 1, false);
-							bool foundDef = preprocessorDefinitions.find(restOfLine) != preprocessorDefinitions.end();
+							bool foundDef = preprocessorDefinitions.Find(restOfLine) != nullptr;
 							preproc.StartSection(isIfDef == foundDef);
 						} else if (sc.Match("else")) {
 							if (!preproc.CurrentIfTaken()) {
@@ -658,7 +555,7 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 							if (!preproc.CurrentIfTaken()) {
 								// Similar to `ifdef
 								std::string restOfLine = GetRestOfLine(styler, sc.currentPos + 6, true);
-								bool ifGood = preprocessorDefinitions.find(restOfLine) != preprocessorDefinitions.end();
+								bool ifGood = preprocessorDefinitions.Find(restOfLine) != nullptr;
 								if (ifGood) {
 									preproc.InvertCurrentLevel();
 									activitySet = preproc.IsInactive() ? activeFlag : 0;
@@ -697,8 +594,7 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 									std::string value;
 									if (startValue < restOfLine.length())
 										value = restOfLine.substr(startValue);
-									preprocessorDefinitions[key] = SymbolValue(value, args);
-									ppDefineHistory.push_back(PPDefinition(curLine, key, value, false, args));
+									ppDefineHistory.Add(preprocessorDefinitions, curLine, key, value, false, args);
 									definitionsChanged = true;
 								} else {
 									// Value
@@ -706,19 +602,16 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 									while ((startValue < restOfLine.length()) && IsSpaceOrTab(restOfLine[startValue]))
 										startValue++;
 									std::string value = restOfLine.substr(startValue);
-									preprocessorDefinitions[key] = value;
-									ppDefineHistory.push_back(PPDefinition(curLine, key, value));
+									ppDefineHistory.Add(preprocessorDefinitions, curLine, key, value, false, "");
 									definitionsChanged = true;
 								}
 							}
 						} else if (sc.Match("undefineall")) {
 							if (options.updatePreprocessor && !preproc.IsInactive()) {
 								// remove all preprocessor definitions
-								std::map<std::string, SymbolValue>::iterator itDef;
-								for(itDef = preprocessorDefinitions.begin(); itDef != preprocessorDefinitions.end(); ++itDef) {
-									ppDefineHistory.push_back(PPDefinition(curLine, itDef->first, "", true));
+								for (const std::string &name : preprocessorDefinitions.Names()) {
+									ppDefineHistory.Add(preprocessorDefinitions, curLine, name, "", true, "");
 								}
-								preprocessorDefinitions.clear();
 								definitionsChanged = true;
 							}
 						} else if (sc.Match("undef")) {
@@ -728,8 +621,7 @@ void SCI_METHOD LexerVerilog::Lex(Sci_PositionU startPos, Sci_Position length, i
 								std::string key;
 								if (tokens.size() >= 1) {
 									key = tokens[0];
-									preprocessorDefinitions.erase(key);
-									ppDefineHistory.push_back(PPDefinition(curLine, key, "", true));
+									ppDefineHistory.Add(preprocessorDefinitions, curLine, key, "", true, "");
 									definitionsChanged = true;
 								}
 							}
@@ -825,18 +717,14 @@ void SCI_METHOD LexerVerilog::Fold(Sci_PositionU startPos, Sci_Position length,
 	int styleNext = MaskActive(styler.StyleAt(startPos));
 	int style = MaskActive(initStyle);
 
-	// restore fold state (if it exists) for prior line
+	// restore fold state for prior line
 	int stateCurrent = 0;
-	std::map<Sci_Position,int>::iterator foldStateIterator = foldState.find(lineCurrent-1);
-	if (foldStateIterator != foldState.end()) {
-		stateCurrent = foldStateIterator->second;
+	if (lineCurrent > 0) {
+		stateCurrent = foldState.ValueAt(lineCurrent-1);
 	}
 
 	// remove all foldState entries after lineCurrent-1
-	foldStateIterator = foldState.upper_bound(lineCurrent-1);
-	if (foldStateIterator != foldState.end()) {
-		foldState.erase(foldStateIterator, foldState.end());
-	}
+	foldState.Delete(lineCurrent);
 
 	for (Sci_PositionU i = startPos; i < endPos; i++) {
 		char ch = chNext;
@@ -1030,9 +918,7 @@ void SCI_METHOD LexerVerilog::Fold(Sci_PositionU startPos, Sci_Position length,
 				lev |= SC_FOLDLEVELWHITEFLAG;
 			if (levelUse < levelNext)
 				lev |= SC_FOLDLEVELHEADERFLAG;
-			if (stateCurrent) {
-				foldState[lineCurrent] = stateCurrent;
-			}
+			foldState.Set(lineCurrent, stateCurrent);
 			if (lev != styler.LevelAt(lineCurrent)) {
 				styler.SetLevel(lineCurrent, lev);
 			}
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <string_view>
+#include <algorithm>
 
 #include "ILexer.h"
 #include "Scintilla.h"
@@ -76,12 +77,32 @@ bool KeywordAtChar(const char* lineBuffer, char* startComment, const WordList &k
 }
 
 #define YAML_STATE_BITSIZE		16
-#define YAML_STATE_MASK			(0xFFFF0000)
+#define YAML_STATE_MASK			(0x000F0000)
+#define YAML_INDENT_MASK		(0x0000FFFF)
 #define YAML_STATE_DOCUMENT		(1 << YAML_STATE_BITSIZE)
 #define YAML_STATE_VALUE		(2 << YAML_STATE_BITSIZE)
 #define YAML_STATE_COMMENT		(3 << YAML_STATE_BITSIZE)
 #define YAML_STATE_TEXT_PARENT	(4 << YAML_STATE_BITSIZE)
 #define YAML_STATE_TEXT			(5 << YAML_STATE_BITSIZE)
+// Count of blank and comment lines ending at each line, up to YAML_SKIP_MAX,
+// so folding can find the previous line with content without reading each line
+#define YAML_SKIP_BITSIZE		20
+#define YAML_SKIP_MAX			0x7FF
+
+constexpr int SkippedLines(int lineState) noexcept {
+	return (lineState >> YAML_SKIP_BITSIZE) & YAML_SKIP_MAX;
+}
+
+// Whether the folder treats the line as a blank or comment line to be skipped
+bool IsSkippedLine(const std::string &lineBuffer) noexcept {
+	if (lineBuffer[0] == '#')
+		return true;
+	for (const char ch : lineBuffer) {
+		if (!IsWhiteSpaceOrEOL(ch))
+			return false;
+	}
+	return true;
+}
 
 void ColouriseYAMLLine(
 	char *lineBuffer,
@@ -100,7 +121,7 @@ void ColouriseYAMLLine(
 		const int parentLineState = styler.GetLineState(currentLine - 1);
 
 		if ((parentLineState&YAML_STATE_MASK) == YAML_STATE_TEXT || (parentLineState&YAML_STATE_MASK) == YAML_STATE_TEXT_PARENT) {
-			const unsigned int parentIndentAmount = parentLineState&(~YAML_STATE_MASK);
+			const unsigned int parentIndentAmount = parentLineState & YAML_INDENT_MASK;
 			if (indentAmount > parentIndentAmount) {
 				styler.SetLineState(currentLine, YAML_STATE_TEXT | parentIndentAmount);
 				styler.ColourTo(endPos, SCE_YAML_TEXT);
@@ -224,18 +245,27 @@ void ColouriseYAMLDoc(Sci_PositionU startPos, Sci_Position length, int, WordList
 	const Sci_PositionU maxPos = styler.Length();
 	Sci_PositionU lineCurrent = styler.GetLine(startPos);
 
+	int skipped = (lineCurrent > 0) ? SkippedLines(styler.GetLineState(lineCurrent - 1)) : 0;
+	auto colouriseLine = [&](Sci_PositionU endLine) {
+		skipped = IsSkippedLine(lineBuffer) ? std::min(skipped + 1, YAML_SKIP_MAX) : 0;
+		ColouriseYAMLLine(lineBuffer.data(), lineCurrent, lineBuffer.length(), startLine, endLine, *keywordLists[0], styler);
+		if (skipped) {
+			styler.SetLineState(lineCurrent, styler.GetLineState(lineCurrent) | (skipped << YAML_SKIP_BITSIZE));
+		}
+	};
+
 	for (Sci_PositionU i = startPos; i < maxPos && i < endPos; i++) {
 		lineBuffer.push_back(styler[i]);
 		if (AtEOL(styler, i)) {
 			// End of line (or of line buffer) met, colourise it
-			ColouriseYAMLLine(lineBuffer.data(), lineCurrent, lineBuffer.length(), startLine, i, *keywordLists[0], styler);
+			colouriseLine(i);
 			lineBuffer.clear();
 			startLine = i + 1;
 			lineCurrent++;
 		}
 	}
 	if (!lineBuffer.empty()) {	// Last line does not have ending characters
-		ColouriseYAMLLine(lineBuffer.data(), lineCurrent, lineBuffer.length(), startLine, startPos + length - 1, *keywordLists[0], styler);
+		colouriseLine(startPos + length - 1);
 	}
 }
 
@@ -259,17 +289,20 @@ void FoldYAMLDoc(Sci_PositionU startPos, Sci_Position length, int /*initStyle -
 	// Backtrack to previous non-blank line so we can determine indent level
 	// for any white space lines
 	// and so we can fix any preceding fold level (which is why we go back
-	// at least one line in all cases)
+	// at least one line in all cases).
+	// The lexer counts the blank and comment lines before each line so
+	// this jumps over them instead of reading each one.
 	int spaceFlags = 0;
 	Sci_Position lineCurrent = styler.GetLine(startPos);
-	int indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
-	while (lineCurrent > 0) {
+	if (lineCurrent > 0) {
 		lineCurrent--;
-		indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
-		if (!(indentCurrent & SC_FOLDLEVELWHITEFLAG) &&
-		        (!IsCommentLine(lineCurrent, styler)))
-			break;
+		int skipped = SkippedLines(styler.GetLineState(lineCurrent));
+		while (skipped && (lineCurrent > 0)) {
+			lineCurrent = std::max<Sci_Position>(lineCurrent - skipped, 0);
+			skipped = SkippedLines(styler.GetLineState(lineCurrent));
+		}
 	}
+	int indentCurrent = styler.IndentAmount(lineCurrent, &spaceFlags, nullptr);
 	int indentCurrentLevel = indentCurrent & SC_FOLDLEVELNUMBERMASK;
 
 	// Set up initial loop state
@@ -8,10 +8,14 @@
 #include <cstring>
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <algorithm>
 
 #include "ILexer.h"
 
+#include "Lexilla.h"
+
 #include "LexAccessor.h"
 #include "CharacterSet.h"
 
@@ -64,6 +68,31 @@ std::string LexAccessor::GetRange(Sci_PositionU startPos_, Sci_PositionU endPos_
 	return s;
 }
 
+IDocumentStyleRuns *LexAccessor::StyleRunsDocument(Scintilla::IDocument *pAccess_, int version) noexcept {
+	if (version == dvStyleRuns) {
+		return static_cast<IDocumentStyleRuns *>(pAccess_);
+	}
+	return nullptr;
+}
+
+void LexAccessor::SetStyleRun(Sci_Position start, Sci_Position length, int style) {
+	pStyleRuns->SetStyleRun(start, length, static_cast<char>(style));
+}
+
+Sci_Position LexAccessor::StyleRunStart(Sci_Position position) const {
+	if (pStyleRuns) {
+		return pStyleRuns->StyleRunStart(position);
+	}
+	if (position <= 0) {
+		return 0;
+	}
+	const int style = StyleIndexAt(position);
+	while ((position > 0) && (StyleIndexAt(position - 1) == style)) {
+		position--;
+	}
+	return position;
+}
+
 std::string LexAccessor::GetRangeLowered(Sci_PositionU startPos_, Sci_PositionU endPos_) const {
 	assert(startPos_ < endPos_);
 	endPos_ = std::min(endPos_, static_cast<Sci_PositionU>(lenDoc));
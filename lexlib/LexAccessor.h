@@ -12,6 +12,8 @@ namespace Lexilla {
 
 enum class EncodingType { eightBit, unicode, dbcs };
 
+class IDocumentStyleRuns;
+
 class LexAccessor {
 private:
 	Scintilla::IDocument *pAccess;
@@ -32,6 +34,8 @@ private:
 	Sci_PositionU startSeg;
 	Sci_Position startPosStyling;
 	int documentVersion;
+	// Set when the document accepts style runs so styleBuf is not used.
+	IDocumentStyleRuns *pStyleRuns;
 
 	void Fill(Sci_Position position) {
 		startPos = position - slopSize;
@@ -55,7 +59,8 @@ public:
 		lenDoc(pAccess->Length()),
 		validLen(0),
 		startSeg(0), startPosStyling(0),
-		documentVersion(pAccess->Version()) {
+		documentVersion(pAccess->Version()),
+		pStyleRuns(StyleRunsDocument(pAccess, documentVersion)) {
 		// Prevent warnings by static analyzers about uninitialized buf and styleBuf.
 		buf[0] = 0;
 		styleBuf[0] = 0;
@@ -122,6 +127,9 @@ public:
 	std::string GetRange(Sci_PositionU startPos_, Sci_PositionU endPos_) const;
 	std::string GetRangeLowered(Sci_PositionU startPos_, Sci_PositionU endPos_) const;
 
+	static IDocumentStyleRuns *StyleRunsDocument(Scintilla::IDocument *pAccess_, int version) noexcept;
+	void SetStyleRun(Sci_Position start, Sci_Position length, int style);
+
 	char StyleAt(Sci_Position position) const {
 		return pAccess->StyleAt(position);
 	}
@@ -140,6 +148,9 @@ public:
 		const unsigned char style = pAccess->StyleAt(position);
 		return style;
 	}
+	// Return the first position of the run of positions with the same style that ends at position.
+	// Documents that store style runs find this directly while others are examined backwards.
+	Sci_Position StyleRunStart(Sci_Position position) const;
 	Sci_Position GetLine(Sci_Position position) const {
 		return pAccess->LineFromPosition(position);
 	}
@@ -187,12 +198,16 @@ public:
 				return;
 			}
 
-			if (validLen + (pos - startSeg + 1) >= bufferSize)
-				Flush();
 			const unsigned char attr = chAttr & 0xffU;
-			if (validLen + (pos - startSeg + 1) >= bufferSize) {
+			if (!pStyleRuns && (validLen + (pos - startSeg + 1) >= bufferSize))
+				Flush();
+			if (pStyleRuns) {
+				// Document stores runs so no need for buffer
+				SetStyleRun(startSeg, pos - startSeg + 1, attr);
+			} else if (validLen + (pos - startSeg + 1) >= bufferSize) {
 				// Too big for buffer so send directly
 				pAccess->SetStyleFor(pos - startSeg + 1, attr);
+				startPosStyling += pos - startSeg + 1;
 			} else {
 				for (Sci_PositionU i = startSeg; i <= pos; i++) {
 					assert((startPosStyling + validLen) < Length());
@@ -0,0 +1,80 @@
+// Scintilla source code edit control
+/** @file LexConvergence.cxx
+ ** Stop lexing early when restyling reaches text that is unchanged since it was last lexed
+ ** and the state carried into it is the same, so the rest would be styled as before.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "LexAccessor.h"
+#include "LexConvergence.h"
+
+using namespace Lexilla;
+
+bool LexConvergence::Active() const noexcept {
+	return converging && (unchangedFrom >= 0);
+}
+
+Sci_Position LexConvergence::LineBefore(Sci_Position line) const noexcept {
+	return line - linesMoved;
+}
+
+bool LexConvergence::AtLineStart(LexAccessor &styler, Sci_Position line, bool sameOther) {
+	if (!Active()) {
+		return false;
+	}
+	const Sci_Position position = styler.LineStart(line);
+	if (sameOther && (line > 0) && (lineHeld == line - 1) && (styler.GetLineState(lineHeld) == lineStateHeld)) {
+		const Sci_Position positionHeld = styler.LineStart(lineHeld);
+		bool same = true;
+		for (Sci_Position i = 0; same && (i < static_cast<Sci_Position>(stylesHeld.length())); i++) {
+			same = styler.BufferStyleAt(positionHeld + i) == static_cast<unsigned char>(stylesHeld[i]);
+		}
+		if (same) {
+			end = position;
+			return true;
+		}
+	}
+	lineHeld = -1;
+	// A line after unchangedFrom is a whole line that was lexed before so hold its old
+	// results before they are overwritten.
+	if (position > unchangedFrom) {
+		const Sci_Position positionNext = styler.LineStart(line + 1);
+		if (positionNext > position) {
+			lineHeld = line;
+			lineStateHeld = styler.GetLineState(line);
+			stylesHeld.clear();
+			for (Sci_Position i = position; i < positionNext; i++) {
+				stylesHeld.push_back(styler.StyleAt(i));
+			}
+		}
+	}
+	return false;
+}
+
+void *LexConvergence::LexConverge(Scintilla::ILexer5 *plex, void *pointer) {
+	LexConvergeRange *pRange = static_cast<LexConvergeRange *>(pointer);
+	if (!plex || !pRange || !pRange->pAccess) {
+		return nullptr;
+	}
+	converging = true;
+	unchangedFrom = pRange->unchangedFrom;
+	linesMoved = pRange->linesMoved;
+	end = -1;
+	lineHeld = -1;
+	plex->Lex(pRange->startPos, pRange->lengthDoc, pRange->initStyle, pRange->pAccess);
+	pRange->end = (end >= 0) ? end : static_cast<Sci_Position>(pRange->startPos + pRange->lengthDoc);
+	converging = false;
+	unchangedFrom = -1;
+	linesMoved = 0;
+	lineHeld = -1;
+	return pointer;
+}
@@ -0,0 +1,41 @@
+// Scintilla source code edit control
+/** @file LexConvergence.h
+ ** Stop lexing early when restyling reaches text that is unchanged since it was last lexed
+ ** and the state carried into it is the same, so the rest would be styled as before.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LEXCONVERGENCE_H
+#define LEXCONVERGENCE_H
+
+namespace Lexilla {
+
+// Implements the LEXILLA_PRIVATECALL_LEXCONVERGE operation for a lexer.
+// The lexer calls AtLineStart in Lex at the start of each line and stops when it returns true.
+// The state carried into a line is taken to be the styles of the previous line, including the
+// line end, its line state, and whatever else the lexer checks for sameOther.
+class LexConvergence {
+	bool converging = false;
+	Sci_Position unchangedFrom = -1;
+	Sci_Position linesMoved = 0;
+	Sci_Position end = -1;
+	// Old styles and line state of lineHeld from before it was lexed again
+	Sci_Position lineHeld = -1;
+	int lineStateHeld = 0;
+	std::string stylesHeld;
+public:
+	// Is this inside LexConverge with some text unchanged?
+	bool Active() const noexcept;
+	// The line number that line had when last lexed, for lexers that hold state for each line.
+	Sci_Position LineBefore(Sci_Position line) const noexcept;
+	// Call at the start of line once the previous line has been styled, including its line end,
+	// and its line state set. sameOther is whether any other state the lexer carries between
+	// lines is the same as when the previous line was last lexed.
+	// Returns true when lexing can stop at the start of line.
+	bool AtLineStart(LexAccessor &styler, Sci_Position line, bool sameOther);
+	void *LexConverge(Scintilla::ILexer5 *plex, void *pointer);
+};
+
+}
+
+#endif
@@ -0,0 +1,28 @@
+// Scintilla source code edit control
+/** @file LexFoldFusion.cxx
+ ** Lex and fold a range in one pass with the folder following just behind the lexer.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "LexFoldFusion.h"
+
+using namespace Lexilla;
+
+bool LexFoldFusion::Active() const noexcept {
+	return folding;
+}
+
+void *LexFoldFusion::LexFold(Scintilla::ILexer5 *plex, void *pointer) {
+	LexFoldRange *pRange = static_cast<LexFoldRange *>(pointer);
+	if (!plex || !pRange || !pRange->pAccess) {
+		return nullptr;
+	}
+	folding = true;
+	plex->Lex(pRange->startPos, pRange->lengthDoc, pRange->initStyle, pRange->pAccess);
+	folding = false;
+	return pointer;
+}
@@ -0,0 +1,28 @@
+// Scintilla source code edit control
+/** @file LexFoldFusion.h
+ ** Lex and fold a range in one pass with the folder following just behind the lexer.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LEXFOLDFUSION_H
+#define LEXFOLDFUSION_H
+
+namespace Lexilla {
+
+// Implements the LEXILLA_PRIVATECALL_LEXFOLD operation for a lexer.
+// LexFold calls Lex and, while Active, Lex also folds the range. The lexer keeps the state of its
+// folder in an object that folds each position once the styles of it and the next position
+// have been set: those before LexAccessor::GetStartSegment. The folder reads styles with
+// LexAccessor::BufferStyleAt and text through the lexer's LexAccessor, so both come from
+// buffers that lexing has just filled. Fold uses the same folder on the whole range.
+class LexFoldFusion {
+	bool folding = false;
+public:
+	// Is this inside LexFold so Lex should also fold?
+	bool Active() const noexcept;
+	void *LexFold(Scintilla::ILexer5 *plex, void *pointer);
+};
+
+}
+
+#endif
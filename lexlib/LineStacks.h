@@ -0,0 +1,87 @@
+// Scintilla source code edit control
+/** @file LineStacks.h
+ ** Hold a stack of lexer states for each line that ends inside nested constructs such as
+ ** interpolated strings. Lines where the stack is empty are not stored.
+ ** The stacks of all lines share one vector so, once it has grown, storing a stack does not
+ ** allocate. This suits the common case of many lines with stacks only 1 or 2 deep.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LINESTACKS_H
+#define LINESTACKS_H
+
+namespace Lexilla {
+
+template <typename T>
+class LineStacks {
+	struct Entry {
+		Sci_Position line;
+		// Index in items of the bottom of the stack
+		size_t start;
+	};
+	// Sorted by line. The stack of entries[i] is items from entries[i].start up to the
+	// start of the next entry.
+	std::vector<Entry> entries;
+	std::vector<T> items;
+
+	size_t Find(Sci_Position line) const noexcept {
+		return std::lower_bound(entries.begin(), entries.end(), line,
+			[](const Entry &entry, Sci_Position l) noexcept {
+				return entry.line < l;
+			}) - entries.begin();
+	}
+	size_t End(size_t index) const noexcept {
+		return (index + 1 < entries.size()) ? entries[index + 1].start : items.size();
+	}
+public:
+	// Number of lines with a stack.
+	size_t Count() const noexcept {
+		return entries.size();
+	}
+	Sci_Position Line(size_t index) const noexcept {
+		return entries[index].line;
+	}
+	size_t Depth(size_t index) const noexcept {
+		return End(index) - entries[index].start;
+	}
+	// Depth(index) elements from the bottom of the stack.
+	const T *Bottom(size_t index) const noexcept {
+		return items.data() + entries[index].start;
+	}
+
+	// Set the stack at the end of line and remove the stacks of later lines.
+	template <typename Stack>
+	void Set(Sci_Position line, const Stack &stack) {
+		Truncate(line);
+		if (!stack.empty()) {
+			entries.push_back({ line, items.size() });
+			items.insert(items.end(), std::begin(stack), std::end(stack));
+		}
+	}
+	// Replace stack with the stack at the end of line and return whether there was one.
+	bool Get(Sci_Position line, std::vector<T> &stack) const {
+		const size_t index = Find(line);
+		if ((index < entries.size()) && (entries[index].line == line)) {
+			stack.assign(Bottom(index), Bottom(index) + Depth(index));
+			return true;
+		}
+		stack.clear();
+		return false;
+	}
+	// Remove the stacks of line and later lines.
+	void Truncate(Sci_Position line) {
+		const size_t index = Find(line);
+		if (index < entries.size()) {
+			items.resize(entries[index].start);
+			entries.resize(index);
+		}
+	}
+	void Clear() noexcept {
+		entries.clear();
+		items.clear();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,462 @@
+// Scintilla source code edit control
+/** @file Preprocessor.h
+ ** Track preprocessor conditionals and definitions for lexers that show inactive code
+ ** differently, such as the C++ and Verilog lexers.
+ ** The lexer recognises the directives and calls these classes to record the state of each
+ ** line, the definitions made by each line, and the results of conditional expressions so
+ ** that lexing can restart at any line without replaying the whole file.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+namespace Lexilla {
+
+// A #define or #undef seen while lexing.
+struct PPDefinition {
+	Sci_Position line;
+	std::string key;
+	std::string value;
+	bool isUndef;
+	std::string arguments;
+	// Identifies the symbol table after this definition, set when first applied
+	uint64_t version = 0;
+	PPDefinition(Sci_Position line_, std::string_view key_, std::string_view value_, bool isUndef_, std::string_view arguments_) :
+		line(line_), key(key_), value(value_), isUndef(isUndef_), arguments(arguments_) {
+	}
+	// Does this make the same change as other wherever they are?
+	[[nodiscard]] bool SameAs(const PPDefinition &other) const noexcept {
+		return (key == other.key) && (value == other.value) && (isUndef == other.isUndef) && (arguments == other.arguments);
+	}
+};
+
+// Track the state of preprocessor conditionals to allow showing active and inactive
+// code in different styles. inactiveFlag is added to the styles of inactive code.
+// Only works up to 31 levels of conditional nesting.
+template <int inactiveFlag>
+class LinePPState {
+	// state is a bit mask with 1 bit per level
+	// bit is 1 for level if section inactive, so any bits set = inactive style
+	int state = 0;
+	// ifTaken is a bit mask with 1 bit per level
+	// bit is 1 for level if some branch at this level has been taken
+	int ifTaken = 0;
+	// level is the nesting level of #if constructs
+	int level = -1;
+	static const int maximumNestingLevel = 31;
+	[[nodiscard]] int maskLevel() const noexcept {
+		if (level >= 0) {
+			return 1 << level;
+		}
+		return 1;
+	}
+public:
+	LinePPState() noexcept = default;
+	[[nodiscard]] bool operator==(const LinePPState &other) const noexcept {
+		return (state == other.state) && (ifTaken == other.ifTaken) && (level == other.level);
+	}
+	[[nodiscard]] bool operator!=(const LinePPState &other) const noexcept {
+		return !(*this == other);
+	}
+	[[nodiscard]] bool ValidLevel() const noexcept {
+		return level >= 0 && level < maximumNestingLevel;
+	}
+	[[nodiscard]] bool IsActive() const noexcept {
+		return state == 0;
+	}
+	[[nodiscard]] bool IsInactive() const noexcept {
+		return state != 0;
+	}
+	[[nodiscard]] int ActiveState() const noexcept {
+		return state ? inactiveFlag : 0;
+	}
+	[[nodiscard]] bool CurrentIfTaken() const noexcept {
+		return (ifTaken & maskLevel()) != 0;
+	}
+	void StartSection(bool on) noexcept {
+		level++;
+		if (ValidLevel()) {
+			if (on) {
+				state &= ~maskLevel();
+				ifTaken |= maskLevel();
+			} else {
+				state |= maskLevel();
+				ifTaken &= ~maskLevel();
+			}
+		}
+	}
+	void EndSection() noexcept {
+		if (ValidLevel()) {
+			state &= ~maskLevel();
+			ifTaken &= ~maskLevel();
+		}
+		level--;
+	}
+	void InvertCurrentLevel() noexcept {
+		if (ValidLevel()) {
+			state ^= maskLevel();
+			ifTaken |= maskLevel();
+		}
+	}
+	template <typename Writer>
+	void Write(Writer &writer) const {
+		writer.Number(state);
+		writer.Number(ifTaken);
+		writer.Number(level);
+	}
+	template <typename Reader>
+	void Read(Reader &reader) noexcept {
+		state = static_cast<int>(reader.Number());
+		ifTaken = static_cast<int>(reader.Number());
+		level = static_cast<int>(reader.Number());
+	}
+};
+
+// Hold the preprocessor state for each line seen.
+// The state only changes on preprocessor lines so only the lines where it changes are stored.
+template <typename LineState>
+class PPStates {
+	struct Change {
+		Sci_Position line;
+		LineState lls;
+	};
+	// In line order with each state different to the one before
+	std::vector<Change> changes;
+	// Lines after those added have the default state
+	Sci_Position lines = 0;
+public:
+	// Is there a change after line?
+	[[nodiscard]] bool ChangesAfter(Sci_Position line) const noexcept {
+		return !changes.empty() && (changes.back().line > line);
+	}
+	// Remove the changes after line and return them, preceded by the state of line, so the
+	// result has the same state as this had for line and the lines after it.
+	[[nodiscard]] PPStates Split(Sci_Position line) {
+		PPStates after;
+		const LineState lls = ForLine(line);
+		if (lls != LineState()) {
+			after.changes.push_back({ line, lls });
+		}
+		const typename std::vector<Change>::iterator it = std::upper_bound(changes.begin(), changes.end(), line,
+			[](Sci_Position lineFind, const Change &change) noexcept { return lineFind < change.line; });
+		after.changes.insert(after.changes.end(), std::make_move_iterator(it), std::make_move_iterator(changes.end()));
+		changes.erase(it, changes.end());
+		after.lines = lines;
+		return after;
+	}
+	// Lexing stopped early at line which had the same state as lineBefore in after, split off
+	// when lexing started, so take the states of later lines from after moved to match.
+	void Resume(PPStates &&after, Sci_Position line, Sci_Position lineBefore) {
+		for (Change &change : after.changes) {
+			if (change.line > lineBefore) {
+				change.line += line - lineBefore;
+				changes.push_back(std::move(change));
+			}
+		}
+		lines = std::max(lines, after.lines + line - lineBefore);
+		after.changes.clear();
+	}
+	[[nodiscard]] LineState ForLine(Sci_Position line) const noexcept {
+		if ((line > 0) && (line < lines)) {
+			const typename std::vector<Change>::const_iterator it = std::upper_bound(changes.begin(), changes.end(), line,
+				[](Sci_Position lineFind, const Change &change) noexcept { return lineFind < change.line; });
+			if (it != changes.begin()) {
+				return (it - 1)->lls;
+			}
+		}
+		return {};
+	}
+	void Add(Sci_Position line, LineState lls) {
+		if (!changes.empty() && (changes.back().line >= line)) {
+			// Forget this line and those after it
+			const typename std::vector<Change>::iterator it = std::lower_bound(changes.begin(), changes.end(), line,
+				[](const Change &change, Sci_Position lineFind) noexcept { return change.line < lineFind; });
+			changes.erase(it, changes.end());
+		}
+		if (changes.empty() ? (lls != LineState()) : (lls != changes.back().lls)) {
+			changes.push_back({ line, lls });
+		}
+		lines = line + 1;
+	}
+	template <typename Writer>
+	void Write(Writer &writer) const {
+		writer.Number(lines);
+		writer.Number(changes.size());
+		for (const Change &change : changes) {
+			writer.Number(change.line);
+			change.lls.Write(writer);
+		}
+	}
+	template <typename Reader>
+	void Read(Reader &reader) {
+		lines = reader.Number();
+		changes.resize(reader.Count());
+		for (Change &change : changes) {
+			change.line = reader.Number();
+			change.lls.Read(reader);
+		}
+	}
+};
+
+struct SymbolValue {
+	std::string value;
+	std::string arguments;
+	SymbolValue() noexcept = default;
+	SymbolValue(std::string_view value_, std::string_view arguments_) : value(value_), arguments(arguments_) {
+	}
+	SymbolValue &operator = (const std::string &value_) {
+		value = value_;
+		arguments.clear();
+		return *this;
+	}
+	[[nodiscard]] bool IsMacro() const noexcept {
+		return !arguments.empty();
+	}
+	[[nodiscard]] bool operator==(const SymbolValue &other) const noexcept {
+		return (value == other.value) && (arguments == other.arguments);
+	}
+};
+using SymbolTable = std::map<std::string, SymbolValue>;
+// Undefined symbols have no value so they hide imported definitions
+using SymbolChanges = std::map<std::string, std::optional<SymbolValue>>;
+
+// The definitions visible at a point in the file: imported definitions and a table that are
+// shared and not modified plus the changes made by #define and #undef since then.
+// Each different set of definitions has a different version.
+class SymbolScope {
+	std::shared_ptr<const SymbolTable> imported;
+	std::shared_ptr<const SymbolChanges> base;
+	SymbolChanges changes;
+	uint64_t version;
+public:
+	SymbolScope(std::shared_ptr<const SymbolTable> imported_, std::shared_ptr<const SymbolChanges> base_, uint64_t version_) noexcept :
+		imported(std::move(imported_)), base(std::move(base_)), version(version_) {
+	}
+	[[nodiscard]] uint64_t Version() const noexcept {
+		return version;
+	}
+	[[nodiscard]] const SymbolValue *Find(const std::string &name) const {
+		const auto itChange = changes.find(name);
+		if (itChange != changes.end()) {
+			return itChange->second ? &*itChange->second : nullptr;
+		}
+		const SymbolChanges::const_iterator itBase = base->find(name);
+		if (itBase != base->end()) {
+			return itBase->second ? &*itBase->second : nullptr;
+		}
+		if (imported) {
+			const SymbolTable::const_iterator it = imported->find(name);
+			if (it != imported->end()) {
+				return &it->second;
+			}
+		}
+		return nullptr;
+	}
+	// Names of all the visible definitions.
+	[[nodiscard]] std::vector<std::string> Names() const {
+		std::vector<std::string> names;
+		if (imported) {
+			for (const auto &[name, value] : *imported) {
+				names.push_back(name);
+			}
+		}
+		for (const auto &[name, value] : *base) {
+			names.push_back(name);
+		}
+		for (const auto &[name, value] : changes) {
+			names.push_back(name);
+		}
+		std::sort(names.begin(), names.end());
+		names.erase(std::unique(names.begin(), names.end()), names.end());
+		names.erase(std::remove_if(names.begin(), names.end(),
+			[this](const std::string &name) { return !Find(name); }), names.end());
+		return names;
+	}
+	void Set(const std::string &name, std::optional<SymbolValue> value, uint64_t version_) {
+		changes[name] = std::move(value);
+		version = version_;
+	}
+	// Combine changes into a new table which becomes the base.
+	// The imported definitions are not copied.
+	std::shared_ptr<const SymbolChanges> Flatten() {
+		std::shared_ptr<SymbolChanges> table = std::make_shared<SymbolChanges>(*base);
+		for (auto &[name, value] : changes) {
+			(*table)[name] = std::move(value);
+		}
+		changes.clear();
+		base = table;
+		return table;
+	}
+};
+
+// The history of #define and #undef in line order along with the definitions that apply
+// before the file.
+// Symbol tables are kept after each definitionsPerCheckpoint entries of the history so that
+// lexing from a line only applies the definitions after the last checkpoint before it.
+class PPDefinitions {
+	std::vector<PPDefinition> history;
+	// Imported definitions are shared by lexers importing the same text
+	std::shared_ptr<const SymbolTable> imported;
+	std::shared_ptr<const SymbolChanges> start = std::make_shared<SymbolChanges>();
+	static constexpr size_t definitionsPerCheckpoint = 128;
+	std::vector<std::shared_ptr<const SymbolChanges>> checkpoints;
+	// Versions are never reused so that results for a version remain valid.
+	uint64_t versionLast = 0;
+	uint64_t versionStart = 0;
+
+	// definitions is in line order
+	static std::vector<PPDefinition>::const_iterator FirstFrom(const std::vector<PPDefinition> &definitions, Sci_Position line) {
+		return std::partition_point(definitions.begin(), definitions.end(),
+			[line](const PPDefinition &p) noexcept { return p.line < line; });
+	}
+	static std::vector<PPDefinition>::iterator FirstFrom(std::vector<PPDefinition> &definitions, Sci_Position line) {
+		return std::partition_point(definitions.begin(), definitions.end(),
+			[line](const PPDefinition &p) noexcept { return p.line < line; });
+	}
+	void StartChanged() {
+		versionStart = ++versionLast;
+		checkpoints.clear();
+		// Versions in history include the old definitions
+		for (PPDefinition &ppDef : history) {
+			ppDef.version = 0;
+		}
+	}
+	void Apply(SymbolScope &scope, size_t index) {
+		PPDefinition &ppDef = history[index];
+		if (ppDef.version == 0) {
+			ppDef.version = ++versionLast;
+		}
+		if (ppDef.isUndef) {
+			scope.Set(ppDef.key, std::nullopt, ppDef.version);
+		} else {
+			scope.Set(ppDef.key, SymbolValue(ppDef.value, ppDef.arguments), ppDef.version);
+		}
+		const size_t definitions = index + 1;
+		if ((definitions % definitionsPerCheckpoint == 0) &&
+			(checkpoints.size() + 1 == definitions / definitionsPerCheckpoint)) {
+			checkpoints.push_back(scope.Flatten());
+		}
+	}
+public:
+	[[nodiscard]] const std::vector<PPDefinition> &History() const noexcept {
+		return history;
+	}
+	[[nodiscard]] size_t Count() const noexcept {
+		return history.size();
+	}
+	// Replace the history, such as when restoring saved state.
+	void SetHistory(std::vector<PPDefinition> &&history_) noexcept {
+		history = std::move(history_);
+		checkpoints.clear();
+	}
+	void Clear() noexcept {
+		history.clear();
+		checkpoints.clear();
+	}
+	// Set the definitions that apply before the file such as those from a word list.
+	void SetStart(std::shared_ptr<const SymbolChanges> start_) {
+		start = std::move(start_);
+		StartChanged();
+	}
+	void Import(std::shared_ptr<const SymbolTable> imported_) {
+		imported = std::move(imported_);
+		StartChanged();
+	}
+	// Remove the definitions made on line or after it and return them, such as to compare
+	// with those made when lexing again.
+	[[nodiscard]] std::vector<PPDefinition> Split(Sci_Position line) {
+		const std::vector<PPDefinition>::iterator itSplit = FirstFrom(history, line);
+		std::vector<PPDefinition> after(std::make_move_iterator(itSplit), std::make_move_iterator(history.end()));
+		history.erase(itSplit, history.end());
+		return after;
+	}
+	// Forget definitions made on line or after it and return whether there were any.
+	bool Truncate(Sci_Position line) {
+		const std::vector<PPDefinition>::const_iterator itInvalid = FirstFrom(history, line);
+		if (itInvalid == history.end()) {
+			return false;
+		}
+		history.erase(itInvalid, history.end());
+		return true;
+	}
+	// Are the definitions after the first count the same as those in before made before lineBefore?
+	[[nodiscard]] bool SameSince(size_t count, const std::vector<PPDefinition> &before, Sci_Position lineBefore) const {
+		const std::vector<PPDefinition>::const_iterator itEnd = FirstFrom(before, lineBefore);
+		return (static_cast<size_t>(itEnd - before.begin()) == history.size() - count) &&
+			std::equal(before.begin(), itEnd, history.begin() + count,
+				[](const PPDefinition &a, const PPDefinition &b) noexcept { return a.SameAs(b); });
+	}
+	// Lexing stopped early at line which was lineBefore when after was split off with the same
+	// definitions so add those made from lineBefore on, moved to match.
+	void Resume(std::vector<PPDefinition> &&after, Sci_Position line, Sci_Position lineBefore) {
+		for (std::vector<PPDefinition>::iterator it = FirstFrom(after, lineBefore); it != after.end(); ++it) {
+			it->line += line - lineBefore;
+			history.push_back(std::move(*it));
+		}
+		after.clear();
+	}
+	// The definitions after the whole history.
+	// Starts from the last valid checkpoint and applies the definitions after it.
+	[[nodiscard]] SymbolScope Scope() {
+		checkpoints.resize(std::min(checkpoints.size(), history.size() / definitionsPerCheckpoint));
+		const size_t checkpointEnd = checkpoints.size() * definitionsPerCheckpoint;
+		SymbolScope scope(imported, checkpoints.empty() ? start : checkpoints.back(),
+			(checkpointEnd == 0) ? versionStart : history[checkpointEnd - 1].version);
+		for (size_t index = checkpointEnd; index < history.size(); index++) {
+			Apply(scope, index);
+		}
+		return scope;
+	}
+	// Append a definition to the history and apply it to scope.
+	void Add(SymbolScope &scope, Sci_Position line, std::string_view key, std::string_view value, bool isUndef, std::string_view arguments) {
+		history.emplace_back(line, key, value, isUndef, arguments);
+		Apply(scope, history.size() - 1);
+	}
+};
+
+// Conditional expressions are tokenized once and their results remembered for each version
+// of the definitions so lexing the same text again does not evaluate again.
+template <typename Tokens>
+class PPExpressionCache {
+	static constexpr size_t expressionsCacheLimit = 10000;
+	std::unordered_map<std::string, Tokens> expressionTokens;
+	std::unordered_map<std::string, bool> expressionResults;
+public:
+	// Call when the way expressions are tokenized or evaluated changes.
+	void Clear() noexcept {
+		expressionTokens.clear();
+		expressionResults.clear();
+	}
+	// tokenize is called with the expression text and returns Tokens.
+	// evaluate is called with a copy of the tokens and returns the result.
+	template <typename TokenizeFunction, typename EvaluateFunction>
+	bool Evaluate(const std::string &expr, const SymbolScope &scope, TokenizeFunction tokenize, EvaluateFunction evaluate) {
+		std::string key = std::to_string(scope.Version());
+		key += ':';
+		key += expr;
+		const auto itResult = expressionResults.find(key);
+		if (itResult != expressionResults.end()) {
+			return itResult->second;
+		}
+
+		if (expressionResults.size() >= expressionsCacheLimit) {
+			expressionResults.clear();
+		}
+		if (expressionTokens.size() >= expressionsCacheLimit) {
+			expressionTokens.clear();
+		}
+		auto itTokens = expressionTokens.find(expr);
+		if (itTokens == expressionTokens.end()) {
+			itTokens = expressionTokens.emplace(expr, tokenize(expr)).first;
+		}
+		Tokens tokens = itTokens->second;
+		const bool result = evaluate(tokens);
+		expressionResults.emplace(std::move(key), result);
+		return result;
+	}
+};
+
+}
+
+#endif
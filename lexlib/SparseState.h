@@ -72,6 +72,13 @@ public:
 	size_t size() const {
 		return states.size();
 	}
+	// Access each state in position order so that it can be saved and later restored with Set.
+	Sci_Position PositionOfIndex(size_t index) const {
+		return states[index].position;
+	}
+	const T &ValueOfIndex(size_t index) const {
+		return states[index].value;
+	}
 
 	// Returns true if Merge caused a significant change
 	bool Merge(const SparseState<T> &other, Sci_Position ignoreAfter) {
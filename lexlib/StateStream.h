@@ -0,0 +1,113 @@
+// Scintilla source code edit control
+/** @file StateStream.h
+ ** Write and read lexer state as bytes for LEXILLA_PRIVATECALL_SAVESTATE and
+ ** LEXILLA_PRIVATECALL_RESTORESTATE.
+ ** Numbers are written with 7 bits per byte so small values take a single byte.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef STATESTREAM_H
+#define STATESTREAM_H
+
+namespace Lexilla {
+
+class StateWriter {
+	std::string data;
+public:
+	// Identify the lexer and the layout of its state so that other state is not restored.
+	void Header(std::string_view name, int version) {
+		String(name);
+		Number(version);
+	}
+	void Number(Sci_Position value) {
+		// Zig-zag encode so that small negative values are also short
+		Sci_PositionU u = static_cast<Sci_PositionU>(value) << 1;
+		if (value < 0) {
+			u = ~u;
+		}
+		while (u >= 0x80) {
+			data.push_back(static_cast<char>((u & 0x7F) | 0x80));
+			u >>= 7;
+		}
+		data.push_back(static_cast<char>(u));
+	}
+	void String(std::string_view sv) {
+		Number(static_cast<Sci_Position>(sv.length()));
+		data.append(sv);
+	}
+	// Copy to the Lexilla::LexerStateBuffer pointer as described for LEXILLA_PRIVATECALL_SAVESTATE.
+	void *CopyTo(void *pointer) const noexcept {
+		LexerStateBuffer *pBuffer = static_cast<LexerStateBuffer *>(pointer);
+		if (!pBuffer) {
+			return nullptr;
+		}
+		if (pBuffer->data && (pBuffer->length >= data.length())) {
+			memcpy(pBuffer->data, data.data(), data.length());
+		}
+		pBuffer->length = data.length();
+		return pointer;
+	}
+};
+
+// Reading past the end or reading malformed values sets failed and returns empty values.
+class StateReader {
+	std::string_view data;
+	bool failed = false;
+public:
+	explicit StateReader(const void *pointer) noexcept {
+		const LexerStateBuffer *pBuffer = static_cast<const LexerStateBuffer *>(pointer);
+		if (pBuffer && pBuffer->data) {
+			data = std::string_view(pBuffer->data, pBuffer->length);
+		} else {
+			failed = true;
+		}
+	}
+	bool Header(std::string_view name, int version) {
+		return (String() == name) && (Number() == version) && !failed;
+	}
+	Sci_Position Number() noexcept {
+		Sci_PositionU u = 0;
+		for (size_t shift = 0; ; shift += 7) {
+			if (data.empty() || (shift >= sizeof(Sci_PositionU) * 8)) {
+				failed = true;
+				return 0;
+			}
+			const unsigned char uch = data.front();
+			data.remove_prefix(1);
+			u |= static_cast<Sci_PositionU>(uch & 0x7F) << shift;
+			if (!(uch & 0x80)) {
+				break;
+			}
+		}
+		const Sci_Position value = static_cast<Sci_Position>(u >> 1);
+		return (u & 1) ? ~value : value;
+	}
+	// The number of items that follow. Each item takes at least one byte so a count larger than
+	// the remaining data is malformed and is treated as 0 to avoid large allocations.
+	size_t Count() noexcept {
+		const Sci_Position count = Number();
+		if ((count < 0) || (static_cast<size_t>(count) > data.length())) {
+			failed = true;
+			return 0;
+		}
+		return count;
+	}
+	std::string String() {
+		const Sci_Position length = Number();
+		if ((length < 0) || (static_cast<size_t>(length) > data.length())) {
+			failed = true;
+			return {};
+		}
+		std::string s(data.substr(0, length));
+		data.remove_prefix(length);
+		return s;
+	}
+	// True when all data has been read without error.
+	bool Complete() const noexcept {
+		return !failed && data.empty();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+// Scintilla source code edit control
+/** @file SubLexer.cxx
+ ** Lex a range of a document with another lexer so that a lexer for a language which embeds
+ ** other languages can use their standalone lexers.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "ILexer.h"
+
+#include "SubLexer.h"
+
+using namespace Lexilla;
+
+namespace {
+
+#if defined(_MSC_VER)
+// IDocument interface does not specify noexcept so best to not add it to implementation
+#pragma warning(disable: 26440)
+#endif
+
+// Passes most calls through to the host document but converts styles, stops styling outside
+// the range being lexed, and keeps separate line states. Fold levels are not changed as the
+// host lexer folds the whole document.
+class RangeDocument : public Scintilla::IDocument {
+	Scintilla::IDocument *pdoc;
+	const SubLexer &sub;
+	std::vector<int> &lineStates;
+	Sci_Position start;
+	Sci_Position end;
+	Sci_Position position;
+	std::string styles;
+
+	// Returns the length of the styles from position that are inside the range and sets skip to
+	// the number of styles before the range.
+	Sci_Position Clip(Sci_Position length, Sci_Position &skip) {
+		skip = std::clamp<Sci_Position>(start - position, 0, length);
+		const Sci_Position endStyle = std::min(position + length, end);
+		return std::max<Sci_Position>(endStyle - (position + skip), 0);
+	}
+public:
+	RangeDocument(Scintilla::IDocument *pdoc_, const SubLexer &sub_, std::vector<int> &lineStates_, Sci_Position start_, Sci_Position end_) :
+		pdoc(pdoc_), sub(sub_), lineStates(lineStates_), start(start_), end(end_), position(start_) {
+	}
+	// Deleted so RangeDocument objects can not be copied.
+	RangeDocument(const RangeDocument &) = delete;
+	RangeDocument(RangeDocument &&) = delete;
+	RangeDocument &operator=(const RangeDocument &) = delete;
+	RangeDocument &operator=(RangeDocument &&) = delete;
+	virtual ~RangeDocument() = default;
+
+	int SCI_METHOD Version() const override {
+		return Scintilla::dvRelease4;
+	}
+	void SCI_METHOD SetErrorStatus(int status) override {
+		pdoc->SetErrorStatus(status);
+	}
+	Sci_Position SCI_METHOD Length() const override {
+		return pdoc->Length();
+	}
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position_, Sci_Position lengthRetrieve) const override {
+		pdoc->GetCharRange(buffer, position_, lengthRetrieve);
+	}
+	char SCI_METHOD StyleAt(Sci_Position position_) const override {
+		// Text styled by the host lexer is seen as the default style
+		return static_cast<char>(sub.LexerStyle(static_cast<unsigned char>(pdoc->StyleAt(position_))));
+	}
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position_) const override {
+		return pdoc->LineFromPosition(position_);
+	}
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override {
+		return pdoc->LineStart(line);
+	}
+	int SCI_METHOD GetLevel(Sci_Position line) const override {
+		return pdoc->GetLevel(line);
+	}
+	int SCI_METHOD SetLevel(Sci_Position, int) override {
+		return 0;
+	}
+	int SCI_METHOD GetLineState(Sci_Position line) const override {
+		if ((line >= 0) && (static_cast<size_t>(line) < lineStates.size())) {
+			return lineStates[line];
+		}
+		return 0;
+	}
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override {
+		if (line < 0) {
+			return 0;
+		}
+		if (static_cast<size_t>(line) >= lineStates.size()) {
+			lineStates.resize(line + 1);
+		}
+		const int stateOld = lineStates[line];
+		lineStates[line] = state;
+		return stateOld;
+	}
+	void SCI_METHOD StartStyling(Sci_Position position_) override {
+		position = position_;
+		pdoc->StartStyling(std::max(position, start));
+	}
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override {
+		Sci_Position skip = 0;
+		const Sci_Position lengthStyle = Clip(length, skip);
+		position += length;
+		if (lengthStyle > 0) {
+			return pdoc->SetStyleFor(lengthStyle, static_cast<char>(sub.DocumentStyle(static_cast<unsigned char>(style))));
+		}
+		return true;
+	}
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles_) override {
+		Sci_Position skip = 0;
+		const Sci_Position lengthStyle = Clip(length, skip);
+		position += length;
+		if (lengthStyle > 0) {
+			styles.resize(lengthStyle);
+			for (Sci_Position i = 0; i < lengthStyle; i++) {
+				styles[i] = static_cast<char>(sub.DocumentStyle(static_cast<unsigned char>(styles_[skip + i])));
+			}
+			return pdoc->SetStyles(lengthStyle, styles.data());
+		}
+		return true;
+	}
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override {
+		pdoc->DecorationSetCurrentIndicator(indicator);
+	}
+	void SCI_METHOD DecorationFillRange(Sci_Position position_, int value, Sci_Position fillLength) override {
+		pdoc->DecorationFillRange(position_, value, fillLength);
+	}
+	void SCI_METHOD ChangeLexerState(Sci_Position start_, Sci_Position end_) override {
+		pdoc->ChangeLexerState(start_, end_);
+	}
+	int SCI_METHOD CodePage() const override {
+		return pdoc->CodePage();
+	}
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override {
+		return pdoc->IsDBCSLeadByte(ch);
+	}
+	const char *SCI_METHOD BufferPointer() override {
+		return pdoc->BufferPointer();
+	}
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override {
+		return pdoc->GetLineIndentation(line);
+	}
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override {
+		return pdoc->LineEnd(line);
+	}
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override {
+		return pdoc->GetRelativePosition(positionStart, characterOffset);
+	}
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position_, Sci_Position *pWidth) const override {
+		return pdoc->GetCharacterAndWidth(position_, pWidth);
+	}
+};
+
+}
+
+SubLexer::SubLexer(Scintilla::ILexer5 *plex_, int styleOffset_, int styleCount_) :
+	plex(plex_), styleOffset(styleOffset_), styleCount(std::max(styleCount_, 1)), documentStyles(0x100) {
+	for (int style = 0; style < static_cast<int>(documentStyles.size()); style++) {
+		int styleShown = style;
+		if (styleShown >= styleCount) {
+			styleShown = plex->PrimaryStyleFromStyle(style);
+			if ((styleShown < 0) || (styleShown >= styleCount)) {
+				styleShown = 0;
+			}
+		}
+		documentStyles[style] = static_cast<unsigned char>(styleOffset + styleShown);
+	}
+}
+
+SubLexer::~SubLexer() {
+	if (plex) {
+		plex->Release();
+	}
+}
+
+Scintilla::ILexer5 *SubLexer::Lexer() const noexcept {
+	return plex;
+}
+
+bool SubLexer::Contains(int style) const noexcept {
+	return (style >= styleOffset) && (style < styleOffset + styleCount);
+}
+
+int SubLexer::DocumentStyle(int style) const noexcept {
+	return documentStyles[style & 0xff];
+}
+
+int SubLexer::LexerStyle(int style) const noexcept {
+	return Contains(style) ? (style - styleOffset) : 0;
+}
+
+void SubLexer::Lex(Scintilla::IDocument *pAccess, Sci_Position start, Sci_Position length, bool continuing) {
+	if (length <= 0) {
+		return;
+	}
+	RangeDocument doc(pAccess, *this, lineStates, start, start + length);
+	const Sci_Position line = pAccess->LineFromPosition(start);
+	// Line states after the start are set again by the sub-lexer
+	if (continuing) {
+		lineStates.resize(std::min(lineStates.size(), static_cast<size_t>(line)));
+	} else {
+		lineStates.resize(static_cast<size_t>(std::max<Sci_Position>(line - 1, 0)));
+	}
+	const int initStyle = (continuing && (start > 0)) ? doc.StyleAt(start - 1) : 0;
+	plex->Lex(start, length, initStyle, &doc);
+}
@@ -0,0 +1,50 @@
+// Scintilla source code edit control
+/** @file SubLexer.h
+ ** Lex a range of a document with another lexer so that a lexer for a language which embeds
+ ** other languages can use their standalone lexers.
+ ** The styles of the other lexer are moved up by an offset into a range not used by the host
+ ** and it has its own line states so does not disturb the host's line states.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef SUBLEXER_H
+#define SUBLEXER_H
+
+namespace Lexilla {
+
+class SubLexer {
+	Scintilla::ILexer5 *plex;
+	int styleOffset;
+	int styleCount;
+	// Document style for each style of the sub-lexer
+	std::vector<unsigned char> documentStyles;
+	std::vector<int> lineStates;
+public:
+	// Takes ownership of plex_. Styles from plex_ are shown as styleOffset_ + style. Those at or
+	// above styleCount_, such as inactive styles and substyles, are shown as their primary style
+	// or, when that is also too high, as the sub-lexer's default style.
+	SubLexer(Scintilla::ILexer5 *plex_, int styleOffset_, int styleCount_);
+	// Deleted so SubLexer objects can not be copied.
+	SubLexer(const SubLexer &) = delete;
+	SubLexer(SubLexer &&) = delete;
+	SubLexer &operator=(const SubLexer &) = delete;
+	SubLexer &operator=(SubLexer &&) = delete;
+	~SubLexer();
+
+	Scintilla::ILexer5 *Lexer() const noexcept;
+	// Is style one that this SubLexer sets?
+	bool Contains(int style) const noexcept;
+	// Convert between the styles of the sub-lexer and the styles in the document.
+	int DocumentStyle(int style) const noexcept;
+	int LexerStyle(int style) const noexcept;
+
+	// Lex [start, start+length) of pAccess which must not be changed outside this range.
+	// When continuing, the text before start was also lexed by this SubLexer and lexing
+	// resumes with its state. Otherwise it starts in the sub-lexer's default state.
+	// The host lexer must flush its LexAccessor before and call StartAt after this.
+	void Lex(Scintilla::IDocument *pAccess, Sci_Position start, Sci_Position length, bool continuing);
+};
+
+}
+
+#endif
@@ -41,8 +41,23 @@ $(DIR_O)/LexAccessor.o: \
 	../lexlib/LexAccessor.cxx \
 	../../scintilla/include/ILexer.h \
 	../../scintilla/include/Sci_Position.h \
+	../include/Lexilla.h \
 	../lexlib/LexAccessor.h \
-	../lexlib/CharacterSet.h
+	../lexlib/CharacterSet.h \
+	../lexlib/LexFoldFusion.h
+$(DIR_O)/LexConvergence.o: \
+	../lexlib/LexConvergence.cxx \
+	../../scintilla/include/ILexer.h \
+	../../scintilla/include/Sci_Position.h \
+	../include/Lexilla.h \
+	../lexlib/LexAccessor.h \
+	../lexlib/LexConvergence.h
+$(DIR_O)/LexFoldFusion.o: \
+	../lexlib/LexFoldFusion.cxx \
+	../../scintilla/include/ILexer.h \
+	../../scintilla/include/Sci_Position.h \
+	../include/Lexilla.h \
+	../lexlib/LexFoldFusion.h
 $(DIR_O)/LexerBase.o: \
 	../lexlib/LexerBase.cxx \
 	../../scintilla/include/ILexer.h \
@@ -92,6 +107,11 @@ $(DIR_O)/StyleContext.o: \
 	../lexlib/Accessor.h \
 	../lexlib/StyleContext.h \
 	../lexlib/CharacterSet.h
+$(DIR_O)/SubLexer.o: \
+	../lexlib/SubLexer.cxx \
+	../../scintilla/include/ILexer.h \
+	../../scintilla/include/Sci_Position.h \
+	../lexlib/SubLexer.h
 $(DIR_O)/WordList.o: \
 	../lexlib/WordList.cxx \
 	../lexlib/WordList.h \
@@ -257,7 +277,8 @@ $(DIR_O)/LexBash.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SubStyles.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LineStacks.h
 $(DIR_O)/LexBasic.o: \
 	../lexers/LexBasic.cxx \
 	../../scintilla/include/ILexer.h \
@@ -402,6 +423,7 @@ $(DIR_O)/LexCPP.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/StringCopy.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
@@ -411,7 +433,12 @@ $(DIR_O)/LexCPP.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SparseState.h \
-	../lexlib/SubStyles.h
+	../lexlib/SubStyles.h \
+	../lexlib/LexFoldFusion.h \
+	../lexlib/LexConvergence.h \
+	../lexlib/StateStream.h \
+	../lexlib/LineStacks.h \
+	../lexlib/Preprocessor.h
 $(DIR_O)/LexCrontab.o: \
 	../lexers/LexCrontab.cxx \
 	../../scintilla/include/ILexer.h \
@@ -474,7 +501,8 @@ $(DIR_O)/LexDart.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LineStacks.h
 $(DIR_O)/LexDataflex.o: \
 	../lexers/LexDataflex.cxx \
 	../../scintilla/include/ILexer.h \
@@ -732,6 +760,7 @@ $(DIR_O)/LexHTML.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/InList.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
@@ -740,8 +769,10 @@ $(DIR_O)/LexHTML.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/SparseState.h \
 	../lexlib/SubStyles.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/SubLexer.h
 $(DIR_O)/LexIndent.o: \
 	../lexers/LexIndent.cxx \
 	../../scintilla/include/ILexer.h \
@@ -772,13 +803,15 @@ $(DIR_O)/LexJSON.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
 	../lexlib/StyleContext.h \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LexConvergence.h
 $(DIR_O)/LexJulia.o: \
 	../lexers/LexJulia.cxx \
 	../../scintilla/include/ILexer.h \
@@ -865,6 +898,7 @@ $(DIR_O)/LexLua.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
 	../lexlib/Accessor.h \
@@ -873,7 +907,8 @@ $(DIR_O)/LexLua.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SubStyles.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LexConvergence.h
 $(DIR_O)/LexMagik.o: \
 	../lexers/LexMagik.cxx \
 	../../scintilla/include/ILexer.h \
@@ -1132,7 +1167,8 @@ $(DIR_O)/LexPerl.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LineStacks.h
 $(DIR_O)/LexPLM.o: \
 	../lexers/LexPLM.cxx \
 	../../scintilla/include/ILexer.h \
@@ -1237,6 +1273,7 @@ $(DIR_O)/LexPython.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
 	../lexlib/Accessor.h \
@@ -1246,7 +1283,11 @@ $(DIR_O)/LexPython.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SubStyles.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LexFoldFusion.h \
+	../lexlib/LexConvergence.h \
+	../lexlib/StateStream.h \
+	../lexlib/LineStacks.h
 $(DIR_O)/LexR.o: \
 	../lexers/LexR.cxx \
 	../../scintilla/include/ILexer.h \
@@ -1316,6 +1357,7 @@ $(DIR_O)/LexRust.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/PropSetSimple.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
@@ -1324,7 +1366,9 @@ $(DIR_O)/LexRust.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LexFoldFusion.h \
+	../lexlib/LexConvergence.h
 $(DIR_O)/LexSAS.o: \
 	../lexers/LexSAS.cxx \
 	../../scintilla/include/ILexer.h \
@@ -1415,6 +1459,7 @@ $(DIR_O)/LexSQL.o: \
 	../../scintilla/include/Sci_Position.h \
 	../../scintilla/include/Scintilla.h \
 	../include/SciLexer.h \
+	../include/Lexilla.h \
 	../lexlib/WordList.h \
 	../lexlib/LexAccessor.h \
 	../lexlib/Accessor.h \
@@ -1423,7 +1468,8 @@ $(DIR_O)/LexSQL.o: \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
 	../lexlib/SparseState.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/LexFoldFusion.h
 $(DIR_O)/LexStata.o: \
 	../lexers/LexStata.cxx \
 	../../scintilla/include/ILexer.h \
@@ -1583,8 +1629,10 @@ $(DIR_O)/LexVerilog.o: \
 	../lexlib/CharacterSet.h \
 	../lexlib/LexerModule.h \
 	../lexlib/OptionSet.h \
+	../lexlib/SparseState.h \
 	../lexlib/SubStyles.h \
-	../lexlib/DefaultLexer.h
+	../lexlib/DefaultLexer.h \
+	../lexlib/Preprocessor.h
 $(DIR_O)/LexVHDL.o: \
 	../lexers/LexVHDL.cxx \
 	../../scintilla/include/ILexer.h \
@@ -218,11 +218,14 @@ LEXLIB_OBJS=\
 	$(DIR_O)\DefaultLexer.obj \
 	$(DIR_O)\InList.obj \
 	$(DIR_O)\LexAccessor.obj \
+	$(DIR_O)\LexConvergence.obj \
+	$(DIR_O)\LexFoldFusion.obj \
 	$(DIR_O)\LexerBase.obj \
 	$(DIR_O)\LexerModule.obj \
 	$(DIR_O)\LexerSimple.obj \
 	$(DIR_O)\PropSetSimple.obj \
 	$(DIR_O)\StyleContext.obj \
+	$(DIR_O)\SubLexer.obj \
 	$(DIR_O)\WordList.obj
 
 # Required by libraries and DLLs that include lexing
@@ -19,11 +19,16 @@
 #include <fstream>
 #include <iomanip>
 #include <filesystem>
+#include <functional>
 
 #include "ILexer.h"
 
 #include "Lexilla.h"
 #include "LexillaAccess.h"
+#include "BatchDocument.h"
+#include "ParallelLexer.h"
+#include "StyleRunAdapter.h"
+#include "LexerSnapshot.h"
 
 #include "TestDocument.h"
 
@@ -582,16 +587,16 @@ int UnixToWindows(std::string &s) {
 
 const std::string BOM = "\xEF\xBB\xBF";
 
-void StyleLineByLine(TestDocument &doc, Scintilla::ILexer5 *plex) {
+void StyleLineByLine(Scintilla::IDocument *pdoc, Scintilla::ILexer5 *plex) {
+	assert(pdoc);
 	assert(plex);
-	Scintilla::IDocument *pdoc = &doc;
-	const Sci_Position lines = doc.LineFromPosition(doc.Length());
+	const Sci_Position lines = pdoc->LineFromPosition(pdoc->Length());
 	Sci_Position startLine = 0;
 	for (Sci_Position line = 0; line <= lines; line++) {
-		const Sci_Position endLine = doc.LineStart(line + 1);
+		const Sci_Position endLine = pdoc->LineStart(line + 1);
 		int styleStart = 0;
 		if (startLine > 0)
-			styleStart = doc.StyleAt(startLine - 1);
+			styleStart = pdoc->StyleAt(startLine - 1);
 		plex->Lex(startLine, endLine - startLine, styleStart, pdoc);
 		plex->Fold(startLine, endLine - startLine, styleStart, pdoc);
 		startLine = endLine;
@@ -659,7 +664,7 @@ bool TestCRLF(std::filesystem::path path, const std::string s, Scintilla::ILexer
 
 	// Test line by line lexing/folding with Unix \n line ends
 	if (!disablePerLineTests && !originalIsUnix) {
-		StyleLineByLine(docUnix, plex);
+		StyleLineByLine(pdocUnix, plex);
 		auto [styledTextNewPerLine, foldedTextNewPerLine] = MarkedAndFoldedDocument(pdocUnix);
 		// Convert results from \n to \r\n run
 		UnixToWindows(styledTextNewPerLine);
@@ -676,6 +681,113 @@ bool TestCRLF(std::filesystem::path path, const std::string s, Scintilla::ILexer
 	return success;
 }
 
+bool TestBatch(const std::filesystem::path &path, std::string_view text, Scintilla::ILexer5 *plex, std::string_view styledText, std::string_view foldedText, bool disablePerLineTests) {
+	assert(plex);
+	// Lex and fold with BatchDocument which borrows text and stores styles as runs then
+	// check results are the same as with TestDocument.
+	Lexilla::BatchDocument docBatch;
+	docBatch.Borrow(text);
+	Scintilla::IDocument *pdoc = &docBatch;
+	plex->Lex(0, pdoc->Length(), 0, pdoc);
+	plex->Fold(0, pdoc->Length(), 0, pdoc);
+	const auto [styledTextBatch, foldedTextBatch] = MarkedAndFoldedDocument(pdoc);
+	bool success = CheckSame(styledText, styledTextBatch, "batch styles", suffixStyled, path);
+	success = CheckSame(foldedText, foldedTextBatch, "batch folds", suffixFolded, path) && success;
+
+	// Each style run should start where the style changes
+	Sci_Position runStart = 0;
+	for (Sci_Position pos = 0; pos < pdoc->Length(); pos++) {
+		if ((pos > 0) && (pdoc->StyleAt(pos - 1) != pdoc->StyleAt(pos))) {
+			runStart = pos;
+		}
+		if (docBatch.StyleRunStart(pos) != runStart) {
+			std::cout << path.string() << ":" << pdoc->LineFromPosition(pos) + 1 <<
+				": style run start differs at " << pos << "\n";
+			success = false;
+			break;
+		}
+	}
+
+	// Reuse the document for line by line lexing/folding which restyles over existing runs
+	if (!disablePerLineTests) {
+		docBatch.Reset();
+		docBatch.Borrow(text);
+		StyleLineByLine(pdoc, plex);
+		const auto [styledTextPerLine, foldedTextPerLine] = MarkedAndFoldedDocument(pdoc);
+		success = CheckSame(styledText, styledTextPerLine, "batch per-line styles", suffixStyled, path) && success;
+		success = CheckSame(foldedText, foldedTextPerLine, "batch per-line folds", suffixFolded, path) && success;
+	}
+	plex->Release();
+	return success;
+}
+
+bool TestStyleRunAdapter(const std::filesystem::path &path, std::string_view text, Scintilla::ILexer5 *plex, std::string_view styledText, std::string_view foldedText) {
+	assert(plex);
+	// Lex and fold through StyleRunAdapter so that LexAccessor sends runs then check that
+	// the wrapped document and the reported runs both match.
+	TestDocument doc;
+	doc.Set(text);
+	std::string stylesFromRuns(text.length(), '\0');
+	{
+		Lexilla::StyleRunAdapter adapter(&doc, [&stylesFromRuns](Sci_Position start, Sci_Position length, char style) {
+			stylesFromRuns.replace(start, length, length, style);
+		});
+		Scintilla::IDocument *pdoc = &adapter;
+		plex->Lex(0, pdoc->Length(), 0, pdoc);
+		plex->Fold(0, pdoc->Length(), 0, pdoc);
+		// Destroying the adapter flushes the styles it still holds
+	}
+	plex->Release();
+	const auto [styledTextAdapter, foldedTextAdapter] = MarkedAndFoldedDocument(&doc);
+	bool success = CheckSame(styledText, styledTextAdapter, "run adapter styles", suffixStyled, path);
+	success = CheckSame(foldedText, foldedTextAdapter, "run adapter folds", suffixFolded, path) && success;
+	for (Sci_Position pos = 0; pos < doc.Length(); pos++) {
+		if (stylesFromRuns[pos] != doc.StyleAt(pos)) {
+			std::cout << path.string() << ":" << doc.LineFromPosition(pos) + 1 <<
+				": style runs differ from document styles at " << pos << "\n";
+			return false;
+		}
+	}
+	return success;
+}
+
+bool TestLexFold(const std::filesystem::path &path, std::string_view text, Scintilla::ILexer5 *plex, std::string_view styledText, std::string_view foldedText, bool disablePerLineTests) {
+	assert(plex);
+	// Lexers that implement LEXILLA_PRIVATECALL_LEXFOLD should produce the same results
+	// as separate Lex and Fold calls. Others return nullptr and are not checked.
+	TestDocument doc;
+	doc.Set(text);
+	Scintilla::IDocument *pdoc = &doc;
+	Lexilla::LexFoldRange range { 0, pdoc->Length(), 0, pdoc };
+	if (!plex->PrivateCall(LEXILLA_PRIVATECALL_LEXFOLD, &range)) {
+		plex->Release();
+		return true;
+	}
+	const auto [styledTextFused, foldedTextFused] = MarkedAndFoldedDocument(pdoc);
+	bool success = CheckSame(styledText, styledTextFused, "lex-fold styles", suffixStyled, path);
+	success = CheckSame(foldedText, foldedTextFused, "lex-fold folds", suffixFolded, path) && success;
+
+	if (!disablePerLineTests) {
+		TestDocument docPerLine;
+		docPerLine.Set(text);
+		pdoc = &docPerLine;
+		const Sci_Position lines = pdoc->LineFromPosition(pdoc->Length());
+		Sci_Position startLine = 0;
+		for (Sci_Position line = 0; line <= lines; line++) {
+			const Sci_Position endLine = pdoc->LineStart(line + 1);
+			const int styleStart = (startLine > 0) ? pdoc->StyleAt(startLine - 1) : 0;
+			range = { static_cast<Sci_PositionU>(startLine), endLine - startLine, styleStart, pdoc };
+			plex->PrivateCall(LEXILLA_PRIVATECALL_LEXFOLD, &range);
+			startLine = endLine;
+		}
+		const auto [styledTextPerLine, foldedTextPerLine] = MarkedAndFoldedDocument(pdoc);
+		success = CheckSame(styledText, styledTextPerLine, "lex-fold per-line styles", suffixStyled, path) && success;
+		success = CheckSame(foldedText, foldedTextPerLine, "lex-fold per-line folds", suffixFolded, path) && success;
+	}
+	plex->Release();
+	return success;
+}
+
 void TestILexer(Scintilla::ILexer5 *plex) {
 	assert(plex);
 
@@ -752,9 +864,17 @@ void TestILexer(Scintilla::ILexer5 *plex) {
 	}
 }
 
+Scintilla::ILexer5 *LEXILLA_CALL CreateEmbeddedLexer(const char *name) {
+	return Lexilla::MakeLexer(name);
+}
+
 bool SetProperties(Scintilla::ILexer5 *plex, const std::string &language, const PropertyMap &propertyMap, std::filesystem::path path) {
 	assert(plex);
 
+	// Lexers that style embedded languages with other lexers, like hypertext, create them here
+	Lexilla::CreateLexerFn createLexer = CreateEmbeddedLexer;
+	plex->PrivateCall(LEXILLA_PRIVATECALL_CREATELEXER, &createLexer);
+
 	const std::string fileName = path.filename().string();
 
 	if (std::string_view bases = plex->GetSubStyleBases(); !bases.empty()) {
@@ -811,6 +931,11 @@ bool SetProperties(Scintilla::ILexer5 *plex, const std::string &language, const
 		}
 	}
 
+	// Import definitions as an application may do for the project that contains a file
+	if (std::optional<std::string> imported = propertyMap.GetProperty("testlexers.import.definitions")) {
+		plex->PrivateCall(LEXILLA_PRIVATECALL_IMPORTDEFINITIONS, imported->data());
+	}
+
 	// Set parameters of lexer
 	for (auto const &[key, val] : propertyMap.properties) {
 		if (key.starts_with("lexer.*")) {
@@ -828,6 +953,198 @@ bool SetProperties(Scintilla::ILexer5 *plex, const std::string &language, const
 }
 
 
+// Give docEdited the styles and line states of doc moved as an editor would after one
+// character is inserted at positionEdit.
+void MoveStylesForInsertion(TestDocument &docEdited, const TestDocument &doc, Sci_Position positionEdit) {
+	docEdited.StartStyling(0);
+	for (Sci_Position pos = 0; pos < docEdited.Length(); pos++) {
+		const Sci_Position posOld = (pos > positionEdit) ? (pos - 1) : pos;
+		docEdited.SetStyleFor(1, (pos == positionEdit) ? 0 : doc.StyleAt(posOld));
+	}
+	for (Sci_Position line = 0; line <= docEdited.MaxLine(); line++) {
+		docEdited.SetLineState(line, doc.GetLineState(line));
+	}
+}
+
+bool TestEdit(const std::filesystem::path &path, std::string_view text, const std::string &language, const PropertyMap &propertyMap, std::string_view styledText, Sci_Position lineEdit) {
+	// Lex the text without the first character of lineEdit, insert that character as if typed,
+	// then lex from the start of lineEdit as an editor would and check the result matches.
+	TestDocument docEdited;
+	docEdited.Set(text);
+	const Sci_Position positionEdit = docEdited.LineStart(lineEdit);
+	if (positionEdit >= docEdited.LineEnd(lineEdit)) {
+		std::cout << "\n" << path.string() << ":" << lineEdit + 1 << ": has no character to edit\n\n";
+		return false;
+	}
+	std::string textBefore(text);
+	textBefore.erase(positionEdit, 1);
+	TestDocument doc;
+	doc.Set(textBefore);
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	plex->Lex(0, doc.Length(), 0, &doc);
+
+	MoveStylesForInsertion(docEdited, doc, positionEdit);
+	const int styleStart = (positionEdit > 0) ? docEdited.StyleAt(positionEdit - 1) : 0;
+	plex->Lex(positionEdit, docEdited.Length() - positionEdit, styleStart, &docEdited);
+	plex->Release();
+	return CheckSame(styledText, MarkedDocument(&docEdited), "edit styles", suffixStyled, path);
+}
+
+bool TestConvergence(const std::filesystem::path &path, std::string_view text, const std::string &language, const PropertyMap &propertyMap, std::string_view styledText) {
+	// Lexers that implement LEXILLA_PRIVATECALL_LEXCONVERGE may stop early after an edit so
+	// insert a space at the start of the middle line then lex from there and check the result
+	// matches lexing the new text from scratch. Others return nullptr and are not checked.
+	TestDocument doc;
+	doc.Set(text);
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	Lexilla::LexConvergeRange range { 0, doc.Length(), 0, &doc, -1, 0, 0 };
+	if (!plex->PrivateCall(LEXILLA_PRIVATECALL_LEXCONVERGE, &range)) {
+		plex->Release();
+		return true;
+	}
+	bool success = CheckSame(styledText, MarkedDocument(&doc), "converge styles", suffixStyled, path);
+
+	const Sci_Position lineEdit = doc.LineFromPosition(doc.Length()) / 2;
+	const Sci_Position positionEdit = doc.LineStart(lineEdit);
+	std::string textEdited(text);
+	textEdited.insert(positionEdit, 1, ' ');
+
+	// Move the old styles and line states as an editor would
+	TestDocument docEdited;
+	docEdited.Set(textEdited);
+	MoveStylesForInsertion(docEdited, doc, positionEdit);
+	const int styleStart = (positionEdit > 0) ? docEdited.StyleAt(positionEdit - 1) : 0;
+	range = { static_cast<Sci_PositionU>(positionEdit), docEdited.Length() - positionEdit, styleStart, &docEdited, positionEdit + 1, 0, 0 };
+	plex->PrivateCall(LEXILLA_PRIVATECALL_LEXCONVERGE, &range);
+	plex->Release();
+
+	if (propertyMap.GetPropertyValue("testlexers.converge.early").value_or(0)) {
+		// The space changes no state so lexing should stop once the line after the edit is seen
+		const Sci_Position lineStop = std::min(lineEdit + 2, docEdited.LineFromPosition(docEdited.Length()));
+		if (range.end > docEdited.LineStart(lineStop)) {
+			std::cout << "\n" << path.string() << ":" << lineStop + 1 << ": has convergence stop at " <<
+				range.end << " instead of " << docEdited.LineStart(lineStop) << "\n\n";
+			success = false;
+		}
+	}
+
+	TestDocument docFresh;
+	docFresh.Set(textEdited);
+	plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	plex->Lex(0, docFresh.Length(), 0, &docFresh);
+	plex->Release();
+	success = CheckSame(MarkedDocument(&docFresh), MarkedDocument(&docEdited), "converge edited styles", suffixStyled, path) && success;
+	return success;
+}
+
+bool TestImportDefinitions(const std::filesystem::path &path, std::string_view text, const std::string &language, const PropertyMap &propertyMap, std::string_view styledText) {
+	// Lexers importing the same definitions share them so a second lexer should still style
+	// with them after the first is released. Importing an empty string removes them so the
+	// result should then match a lexer that imported NULL and differ from styledText.
+	Scintilla::ILexer5 *plexFirst = Lexilla::MakeLexer(language);
+	SetProperties(plexFirst, language, propertyMap, path);
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	plexFirst->Release();
+
+	TestDocument doc;
+	doc.Set(text);
+	plex->Lex(0, doc.Length(), 0, &doc);
+	bool success = CheckSame(styledText, MarkedDocument(&doc), "shared import styles", suffixStyled, path);
+
+	char empty[] = "";
+	plex->PrivateCall(LEXILLA_PRIVATECALL_IMPORTDEFINITIONS, empty);
+	TestDocument docCleared;
+	docCleared.Set(text);
+	plex->Lex(0, docCleared.Length(), 0, &docCleared);
+	plex->Release();
+
+	TestDocument docNone;
+	docNone.Set(text);
+	Scintilla::ILexer5 *plexNone = Lexilla::MakeLexer(language);
+	SetProperties(plexNone, language, propertyMap, path);
+	plexNone->PrivateCall(LEXILLA_PRIVATECALL_IMPORTDEFINITIONS, nullptr);
+	plexNone->Lex(0, docNone.Length(), 0, &docNone);
+	plexNone->Release();
+
+	const std::string styledCleared = MarkedDocument(&docCleared);
+	if (styledCleared == styledText) {
+		std::cout << "\n" << path.string() << ":1: has the same styles after removing imported definitions\n\n";
+		success = false;
+	}
+	return CheckSame(MarkedDocument(&docNone), styledCleared, "cleared import styles", suffixStyled, path) && success;
+}
+
+bool TestParallel(const std::filesystem::path &path, std::string_view text, const std::string &language, const PropertyMap &propertyMap, std::string_view styledText, std::string_view foldedText) {
+	// Use several chunks even for small examples so that joining chunks is exercised.
+	constexpr size_t chunks = 4;
+	Lexilla::BatchDocument docParallel;
+	docParallel.Borrow(text);
+	const Lexilla::LexerMaker maker = [&]() {
+		Scintilla::ILexer5 *plex = Lexilla::MakeLexer(language);
+		SetProperties(plex, language, propertyMap, path);
+		return plex;
+	};
+	Lexilla::LexParallel(docParallel, maker, chunks, 1, true);
+	const auto [styledTextParallel, foldedTextParallel] = MarkedAndFoldedDocument(&docParallel);
+	const bool success = CheckSame(styledText, styledTextParallel, "parallel styles", suffixStyled, path);
+	const std::optional<int> foldsDisable = propertyMap.GetPropertyValue("testlexers.parallel.folds.disable");
+	if (foldsDisable.value_or(false)) {
+		return success;
+	}
+	return CheckSame(foldedText, foldedTextParallel, "parallel folds", suffixFolded, path) && success;
+}
+
+bool TestSnapshot(const std::filesystem::path &path, std::string_view text, const std::string &language, const PropertyMap &propertyMap, std::string_view styledText, std::string_view foldedText) {
+	// Lex the first half of the lines and save a snapshot then restore the snapshot into the
+	// whole text with a new lexer and continue lexing. Lexers that can not save their state
+	// are not checked.
+	Lexilla::BatchDocument docPrefix;
+	docPrefix.Borrow(text);
+	const Sci_Position lineMiddle = docPrefix.LineCount() / 2;
+	const Sci_Position positionMiddle = docPrefix.LineStart(lineMiddle);
+	docPrefix.Borrow(text.substr(0, positionMiddle));
+	Scintilla::ILexer5 *plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	plex->Lex(0, docPrefix.Length(), 0, &docPrefix);
+	plex->Fold(0, docPrefix.Length(), 0, &docPrefix);
+	Lexilla::LexerSnapshot snapshotSaved(4);
+	const bool saved = snapshotSaved.Save(docPrefix, plex);
+	plex->Release();
+	if (!saved) {
+		return true;
+	}
+
+	// Write to bytes and back to check serialization
+	Lexilla::LexerSnapshot snapshot;
+	if (!snapshot.Deserialize(snapshotSaved.Serialize())) {
+		std::cout << path.string() << ":1: snapshot could not be deserialized\n";
+		return false;
+	}
+
+	Lexilla::BatchDocument doc;
+	doc.Borrow(text);
+	plex = Lexilla::MakeLexer(language);
+	SetProperties(plex, language, propertyMap, path);
+	const Sci_Position position = snapshot.Restore(doc, plex);
+	if ((lineMiddle > 0) && (position != positionMiddle)) {
+		std::cout << path.string() << ":" << lineMiddle + 1 << ": snapshot restored to " << position <<
+			" instead of " << positionMiddle << "\n";
+		plex->Release();
+		return false;
+	}
+	const int styleStart = (position > 0) ? doc.StyleAt(position - 1) : 0;
+	plex->Lex(position, doc.Length() - position, styleStart, &doc);
+	plex->Fold(position, doc.Length() - position, styleStart, &doc);
+	plex->Release();
+	const auto [styledTextRestored, foldedTextRestored] = MarkedAndFoldedDocument(&doc);
+	const bool success = CheckSame(styledText, styledTextRestored, "snapshot styles", suffixStyled, path);
+	return CheckSame(foldedText, foldedTextRestored, "snapshot folds", suffixFolded, path) && success;
+}
+
 bool TestFile(const std::filesystem::path &path, const PropertyMap &propertyMap) {
 	// Find and create correct lexer
 	std::optional<std::string> language = propertyMap.GetPropertyForFile(lexerPrefix, path.filename().string());
@@ -907,12 +1224,52 @@ bool TestFile(const std::filesystem::path &path, const PropertyMap &propertyMap)
 		if (!SetProperties(plexPerLine, *language, propertyMap, path)) {
 			return false;
 		}
-		StyleLineByLine(docPerLine, plexPerLine);
+		StyleLineByLine(&docPerLine, plexPerLine);
 		const auto [styledTextNewPerLine, foldedTextNewPerLine] = MarkedAndFoldedDocument(&docPerLine);
 		success = success && CheckSame(styledText, styledTextNewPerLine, "per-line styles", suffixStyled, path);
 		success = success && CheckSame(foldedText, foldedTextNewPerLine, "per-line folds", suffixFolded, path);
 	}
 
+	if (success) {
+		Scintilla::ILexer5 *plexBatch = Lexilla::MakeLexer(*language);
+		SetProperties(plexBatch, *language, propertyMap, path);
+		success = TestBatch(path, text, plexBatch, styledText, foldedText, disablePerLineTests);
+	}
+
+	if (success) {
+		Scintilla::ILexer5 *plexAdapter = Lexilla::MakeLexer(*language);
+		SetProperties(plexAdapter, *language, propertyMap, path);
+		success = TestStyleRunAdapter(path, text, plexAdapter, styledText, foldedText);
+	}
+
+	if (success) {
+		Scintilla::ILexer5 *plexLexFold = Lexilla::MakeLexer(*language);
+		SetProperties(plexLexFold, *language, propertyMap, path);
+		success = TestLexFold(path, text, plexLexFold, styledText, foldedText, disablePerLineTests);
+	}
+
+	const std::optional<int> parallelDisable = propertyMap.GetPropertyValue("testlexers.parallel.disable");
+	if (success && !parallelDisable.value_or(false)) {
+		success = TestParallel(path, text, *language, propertyMap, styledText, foldedText);
+	}
+
+	const std::optional<int> editLine = propertyMap.GetPropertyValue("testlexers.edit.line");
+	if (success && editLine) {
+		success = TestEdit(path, text, *language, propertyMap, styledText, *editLine - 1);
+	}
+
+	if (success && propertyMap.GetProperty("testlexers.import.definitions")) {
+		success = TestImportDefinitions(path, text, *language, propertyMap, styledText);
+	}
+
+	if (success && !disablePerLineTests) {
+		success = TestConvergence(path, text, *language, propertyMap, styledText);
+	}
+
+	if (success && !disablePerLineTests) {
+		success = TestSnapshot(path, text, *language, propertyMap, styledText, foldedText);
+	}
+
 	if (success) {
 		Scintilla::ILexer5 *plexCRLF = Lexilla::MakeLexer(*language);
 		SetProperties(plexCRLF, *language, propertyMap, path.filename().string());
@@ -0,0 +1,21 @@
+// Definitions imported through LEXILLA_PRIVATECALL_IMPORTDEFINITIONS
+#if IMPORTED
+int imported;
+#else
+int missing;
+#endif
+
+#if VER(1,2) == 12
+int macro;
+#endif
+
+// Definitions in the file override imported definitions
+#undef IMPORTED
+#if IMPORTED
+int undefined;
+#endif
+
+#define IMPORTED 2
+#if IMPORTED == 2
+int redefined;
+#endif
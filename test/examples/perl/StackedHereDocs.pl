@@ -0,0 +1,22 @@
+# Here docs started on one line have their text in order
+print <<A, <<"B", <<'C';
+text of A $x
+A
+text of B $y
+B
+text of C $z
+C
+print "after\n";
+
+# Indented and stacked
+my @list = (<<~EOT, <<\EOQ);
+    indented $a
+    EOT
+quoted $b
+EOQ
+
+# Left shift between here docs does not lose the first
+my $v = <<X . (1 << 2);
+text of X
+X
+$v <<= 1;
@@ -0,0 +1,17 @@
+# Folding of triple quoted strings with fold.quotes.python=1
+
+def f():
+    """Documentation
+    over several lines
+
+    with a blank line
+    """
+    s = """
+starting at the left
+"""
+    return s
+
+class C:
+    '''
+    single quotes'''
+    pass
@@ -0,0 +1,5 @@
+# A continued string left unterminated on its next line is styled
+# as unterminated from where it started
+f" \
+\"
+x = 1
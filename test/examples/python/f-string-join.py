@@ -0,0 +1,13 @@
+a = 1
+b = 2
+c = 3
+x = 0
+y = 9
+d = f"""start {
+a +
+b
+} end"""
+e = 4
+f = 5
+g = 6
+h = 7
@@ -0,0 +1,14 @@
+-- Blocks of line comments fold with fold.comment=1
+-- second line of block
+-- third line
+select 1;
+
+-- single comment
+select 2;
+/* stream
+   comment */
+--{
+select 3;
+--}
+-- block
+-- at end
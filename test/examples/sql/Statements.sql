@@ -0,0 +1,30 @@
+-- Statements split into chunks at lines after ';'
+create table t (
+	id int,
+	name varchar(20)
+);
+insert into t values (1, 'a;
+b');
+/* comment ending in ;
+*/
+create view v as
+select id,
+	case when id > 1 then 'big'
+	else 'small'
+	end
+from t;
+begin
+	case x
+	when 1 then
+		select 1;
+	when 2 then
+		select 2;
+	end case;
+	if a then
+		select 3;
+	end if;
+end;
+merge into t using s on (t.id = s.id)
+when matched then
+	update set name = s.name;
+select * from t;
@@ -19,7 +19,7 @@ DEBUG_OPTIONS = -O2 -MT -DNDEBUG $(STATIC_FLAG) -GL
 
 CXXFLAGS = /EHsc /std:c++latest $(DEBUG_OPTIONS) $(INCLUDEDIRS)
 
-OBJS = TestLexers.obj TestDocument.obj LexillaAccess.obj
+OBJS = TestLexers.obj TestDocument.obj LexillaAccess.obj BatchDocument.obj ParallelLexer.obj StyleRunAdapter.obj LexerSnapshot.obj
 
 all: $(EXE)
 
@@ -37,5 +37,9 @@ $(EXE): $(OBJS) $(LIBS)
 {..\access}.cxx.obj::
 	$(CXX) $(CXXFLAGS) -c $<
 
-TestLexers.obj: $*.cxx TestDocument.h
+TestLexers.obj: $*.cxx TestDocument.h ..\access\BatchDocument.h ..\access\ParallelLexer.h ..\access\StyleRunAdapter.h ..\access\LexerSnapshot.h
+BatchDocument.obj: ..\access\$*.cxx ..\access\$*.h
+ParallelLexer.obj: ..\access\$*.cxx ..\access\$*.h ..\access\BatchDocument.h
+StyleRunAdapter.obj: ..\access\$*.cxx ..\access\$*.h
+LexerSnapshot.obj: ..\access\$*.cxx ..\access\$*.h ..\access\BatchDocument.h
 TestDocument.obj: $*.cxx $*.h
@@ -15,9 +15,11 @@ TESTEDSRC=\
  ../../lexlib/Accessor.cxx \
  ../../lexlib/CharacterSet.cxx \
  ../../lexlib/InList.cxx \
+ ../../lexlib/LexAccessor.cxx \
  ../../lexlib/LexerBase.cxx \
  ../../lexlib/LexerModule.cxx \
  ../../lexlib/LexerSimple.cxx \
+ ../../lexlib/LexFoldFusion.cxx \
  ../../lexlib/PropSetSimple.cxx \
  ../../lexlib/WordList.cxx
 
@@ -0,0 +1,69 @@
+/** @file testLineStacks.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+#include "Sci_Position.h"
+
+#include "LineStacks.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+// Test LineStacks.
+
+TEST_CASE("LineStacks") {
+
+	LineStacks<int> ls;
+	std::vector<int> stack { 99 };
+
+	SECTION("IsEmptyInitially") {
+		REQUIRE(0u == ls.Count());
+		REQUIRE(!ls.Get(0, stack));
+		REQUIRE(stack.empty());
+	}
+
+	SECTION("SetAndGet") {
+		ls.Set(2, std::vector<int> { 1 });
+		ls.Set(5, std::vector<int> { 2, 3 });
+		REQUIRE(2u == ls.Count());
+		REQUIRE(ls.Get(2, stack));
+		REQUIRE(stack == std::vector<int> { 1 });
+		REQUIRE(ls.Get(5, stack));
+		REQUIRE(stack == std::vector<int> { 2, 3 });
+		REQUIRE(!ls.Get(3, stack));
+		REQUIRE(5 == ls.Line(1));
+		REQUIRE(2u == ls.Depth(1));
+		REQUIRE(3 == ls.Bottom(1)[1]);
+	}
+
+	SECTION("EmptyNotStored") {
+		ls.Set(2, std::vector<int> {});
+		REQUIRE(0u == ls.Count());
+	}
+
+	SECTION("SetRemovesLater") {
+		ls.Set(2, std::vector<int> { 1 });
+		ls.Set(5, std::vector<int> { 2, 3 });
+		ls.Set(7, std::vector<int> { 4 });
+		ls.Set(5, std::vector<int> { 6 });
+		REQUIRE(2u == ls.Count());
+		REQUIRE(ls.Get(5, stack));
+		REQUIRE(stack == std::vector<int> { 6 });
+		REQUIRE(!ls.Get(7, stack));
+	}
+
+	SECTION("Truncate") {
+		ls.Set(2, std::vector<int> { 1 });
+		ls.Set(5, std::vector<int> { 2, 3 });
+		ls.Truncate(3);
+		REQUIRE(1u == ls.Count());
+		REQUIRE(ls.Get(2, stack));
+		ls.Truncate(0);
+		REQUIRE(0u == ls.Count());
+	}
+}
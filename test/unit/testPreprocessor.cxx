@@ -0,0 +1,212 @@
+/** @file testPreprocessor.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <optional>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+#include "Sci_Position.h"
+
+#include "Preprocessor.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+// Test preprocessor state tracking.
+
+using LineState = LinePPState<0x40>;
+
+TEST_CASE("PPStates") {
+
+	PPStates<LineState> states;
+	LineState inactive;
+	inactive.StartSection(false);
+
+	SECTION("IsDefaultInitially") {
+		REQUIRE(states.ForLine(3) == LineState());
+		REQUIRE(!states.ChangesAfter(0));
+	}
+
+	SECTION("AddAndFind") {
+		states.Add(1, LineState());
+		states.Add(2, inactive);
+		states.Add(3, inactive);
+		states.Add(4, LineState());
+		REQUIRE(states.ForLine(1) == LineState());
+		REQUIRE(states.ForLine(3) == inactive);
+		REQUIRE(states.ForLine(3).ActiveState() == 0x40);
+		REQUIRE(states.ForLine(4) == LineState());
+		REQUIRE(states.ChangesAfter(3));
+		// Not yet lexed
+		REQUIRE(states.ForLine(6) == LineState());
+	}
+
+	SECTION("AddForgetsLater") {
+		states.Add(2, inactive);
+		states.Add(4, LineState());
+		states.Add(3, inactive);
+		REQUIRE(!states.ChangesAfter(2));
+		REQUIRE(states.ForLine(3) == inactive);
+	}
+
+	SECTION("SplitKeepsStates") {
+		states.Add(1, LineState());
+		states.Add(2, inactive);
+		states.Add(5, LineState());
+		const PPStates<LineState> after = states.Split(3);
+		REQUIRE(!states.ChangesAfter(2));
+		REQUIRE(states.ForLine(3) == inactive);
+		REQUIRE(after.ForLine(3) == inactive);
+		REQUIRE(after.ForLine(4) == inactive);
+		REQUIRE(after.ForLine(5) == LineState());
+		REQUIRE(after.ChangesAfter(4));
+	}
+
+	SECTION("ResumeMovesLater") {
+		states.Add(1, LineState());
+		states.Add(2, inactive);
+		states.Add(5, LineState());
+		states.Add(8, LineState());
+		PPStates<LineState> before = states.Split(1);
+		// Lexed again from line 1 after inserting 2 lines and stopped at line 4 which was line 2
+		states.Add(2, LineState());
+		states.Add(3, LineState());
+		states.Add(4, inactive);
+		REQUIRE(before.ForLine(2) == inactive);
+		states.Resume(std::move(before), 4, 2);
+		REQUIRE(states.ForLine(3) == LineState());
+		REQUIRE(states.ForLine(6) == inactive);
+		REQUIRE(states.ForLine(7) == LineState());
+		REQUIRE(states.ForLine(10) == LineState());
+		REQUIRE(!states.ChangesAfter(7));
+	}
+}
+
+TEST_CASE("PPDefinitions") {
+
+	PPDefinitions definitions;
+
+	SECTION("StartDefinitions") {
+		std::shared_ptr<SymbolChanges> start = std::make_shared<SymbolChanges>();
+		(*start)["A"] = SymbolValue("1", "");
+		definitions.SetStart(start);
+		const SymbolScope scope = definitions.Scope();
+		REQUIRE(scope.Find("A"));
+		REQUIRE(scope.Find("A")->value == "1");
+		REQUIRE(!scope.Find("B"));
+	}
+
+	SECTION("AddAndTruncate") {
+		SymbolScope scope = definitions.Scope();
+		definitions.Add(scope, 2, "A", "1", false, "");
+		definitions.Add(scope, 5, "B", "2", false, "x");
+		definitions.Add(scope, 7, "A", "", true, "");
+		REQUIRE(!scope.Find("A"));
+		REQUIRE(scope.Find("B")->IsMacro());
+		REQUIRE(definitions.Count() == 3);
+
+		REQUIRE(definitions.Truncate(5));
+		REQUIRE(definitions.Count() == 1);
+		REQUIRE(!definitions.Truncate(5));
+		const SymbolScope scopeTruncated = definitions.Scope();
+		REQUIRE(scopeTruncated.Find("A"));
+		REQUIRE(!scopeTruncated.Find("B"));
+	}
+
+	SECTION("SameSinceAndResume") {
+		SymbolScope scope = definitions.Scope();
+		definitions.Add(scope, 2, "A", "1", false, "");
+		definitions.Add(scope, 5, "B", "2", false, "x");
+		definitions.Add(scope, 7, "A", "", true, "");
+		std::vector<PPDefinition> before = definitions.Split(2);
+		REQUIRE(before.size() == 3);
+		REQUIRE(definitions.Count() == 0);
+
+		// Lexed again from line 2 after inserting a line before line 5
+		SymbolScope scopeAgain = definitions.Scope();
+		definitions.Add(scopeAgain, 2, "A", "1", false, "");
+		REQUIRE(!definitions.SameSince(0, before, 6));
+		definitions.Add(scopeAgain, 6, "B", "2", false, "x");
+		REQUIRE(definitions.SameSince(0, before, 6));
+		REQUIRE(!definitions.SameSince(0, before, 8));
+
+		definitions.Resume(std::move(before), 7, 6);
+		REQUIRE(definitions.Count() == 3);
+		REQUIRE(definitions.History().back().line == 8);
+		REQUIRE(!definitions.Scope().Find("A"));
+	}
+
+	SECTION("SameSinceComparesDefinitions") {
+		SymbolScope scope = definitions.Scope();
+		definitions.Add(scope, 2, "A", "1", false, "");
+		const std::vector<PPDefinition> before = definitions.Split(0);
+		SymbolScope scopeAgain = definitions.Scope();
+		definitions.Add(scopeAgain, 2, "A", "2", false, "");
+		REQUIRE(!definitions.SameSince(0, before, 3));
+	}
+
+	SECTION("Checkpoints") {
+		// Enough definitions for several checkpoints
+		SymbolScope scope = definitions.Scope();
+		for (int i = 0; i < 1000; i++) {
+			definitions.Add(scope, i, "S" + std::to_string(i % 300), std::to_string(i), false, "");
+		}
+		REQUIRE(scope.Find("S10")->value == "910");
+		definitions.Truncate(500);
+		const SymbolScope scopeTruncated = definitions.Scope();
+		REQUIRE(scopeTruncated.Find("S10")->value == "310");
+		REQUIRE(scopeTruncated.Find("S299")->value == "299");
+		REQUIRE(scopeTruncated.Version() != scope.Version());
+	}
+
+	SECTION("Names") {
+		SymbolScope scope = definitions.Scope();
+		definitions.Add(scope, 1, "B", "1", false, "");
+		definitions.Add(scope, 2, "A", "1", false, "");
+		definitions.Add(scope, 3, "C", "1", false, "");
+		definitions.Add(scope, 4, "B", "", true, "");
+		REQUIRE(scope.Names() == std::vector<std::string> { "A", "C" });
+	}
+}
+
+TEST_CASE("PPExpressionCache") {
+
+	PPExpressionCache<std::vector<std::string>> cache;
+	PPDefinitions definitions;
+	SymbolScope scope = definitions.Scope();
+	int tokenized = 0;
+	int evaluated = 0;
+	auto tokenize = [&tokenized](const std::string &text) {
+		tokenized++;
+		return std::vector<std::string> { text };
+	};
+	auto evaluate = [&evaluated, &scope](std::vector<std::string> &tokens) {
+		evaluated++;
+		return scope.Find(tokens[0]) != nullptr;
+	};
+
+	SECTION("RemembersResults") {
+		REQUIRE(!cache.Evaluate("A", scope, tokenize, evaluate));
+		REQUIRE(!cache.Evaluate("A", scope, tokenize, evaluate));
+		REQUIRE(tokenized == 1);
+		REQUIRE(evaluated == 1);
+	}
+
+	SECTION("EvaluatesForNewVersion") {
+		REQUIRE(!cache.Evaluate("A", scope, tokenize, evaluate));
+		definitions.Add(scope, 1, "A", "1", false, "");
+		REQUIRE(cache.Evaluate("A", scope, tokenize, evaluate));
+		REQUIRE(tokenized == 1);
+		REQUIRE(evaluated == 2);
+	}
+}
@@ -0,0 +1,107 @@
+/** @file testStateStream.cxx
+ ** Unit Tests for Lexilla internal data structures
+ **/
+
+#include <cstring>
+
+#include <string>
+#include <string_view>
+
+#include "ILexer.h"
+
+#include "Lexilla.h"
+
+#include "StateStream.h"
+
+#include "catch.hpp"
+
+using namespace Lexilla;
+
+namespace {
+
+std::string Saved(const StateWriter &writer) {
+	LexerStateBuffer buffer{ nullptr, 0 };
+	REQUIRE(writer.CopyTo(&buffer) == &buffer);
+	std::string data(buffer.length, '\0');
+	buffer.data = data.data();
+	REQUIRE(writer.CopyTo(&buffer) == &buffer);
+	REQUIRE(buffer.length == data.length());
+	return data;
+}
+
+}
+
+// Test StateWriter and StateReader.
+
+TEST_CASE("StateStream") {
+
+	StateWriter writer;
+
+	SECTION("RoundTrip") {
+		writer.Header("test", 3);
+		writer.Number(0);
+		writer.Number(1);
+		writer.Number(-1);
+		writer.Number(127);
+		writer.Number(128);
+		writer.Number(-100000);
+		writer.Number(0x12345678);
+		writer.String("");
+		writer.String("abc");
+		const std::string data = Saved(writer);
+		LexerStateBuffer buffer{ const_cast<char *>(data.data()), data.length() };
+		StateReader reader(&buffer);
+		REQUIRE(reader.Header("test", 3));
+		REQUIRE(0 == reader.Number());
+		REQUIRE(1 == reader.Number());
+		REQUIRE(-1 == reader.Number());
+		REQUIRE(127 == reader.Number());
+		REQUIRE(128 == reader.Number());
+		REQUIRE(-100000 == reader.Number());
+		REQUIRE(0x12345678 == reader.Number());
+		REQUIRE(reader.String().empty());
+		REQUIRE("abc" == reader.String());
+		REQUIRE(reader.Complete());
+	}
+
+	SECTION("SmallNumbersShort") {
+		writer.Number(63);
+		writer.Number(-64);
+		REQUIRE(2 == Saved(writer).length());
+	}
+
+	SECTION("DifferentHeader") {
+		writer.Header("test", 3);
+		const std::string data = Saved(writer);
+		LexerStateBuffer buffer{ const_cast<char *>(data.data()), data.length() };
+		StateReader readerName(&buffer);
+		REQUIRE(!readerName.Header("other", 3));
+		StateReader readerVersion(&buffer);
+		REQUIRE(!readerVersion.Header("test", 4));
+	}
+
+	SECTION("Truncated") {
+		writer.String("abcdef");
+		std::string data = Saved(writer);
+		data.pop_back();
+		LexerStateBuffer buffer{ data.data(), data.length() };
+		StateReader reader(&buffer);
+		REQUIRE(reader.String().empty());
+		REQUIRE(!reader.Complete());
+	}
+
+	SECTION("CountTooLarge") {
+		writer.Number(1000);
+		const std::string data = Saved(writer);
+		LexerStateBuffer buffer{ const_cast<char *>(data.data()), data.length() };
+		StateReader reader(&buffer);
+		REQUIRE(0 == reader.Count());
+		REQUIRE(!reader.Complete());
+	}
+
+	SECTION("NoData") {
+		StateReader reader(nullptr);
+		REQUIRE(!reader.Header("test", 3));
+		REQUIRE(!reader.Complete());
+	}
+}